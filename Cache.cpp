@@ -6,6 +6,8 @@
 #include <random>
 #include <utility>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 
 int Cache::numSets = 0;
 int Cache::numBlocks = 0;
@@ -13,19 +15,114 @@ int Cache::readHit = 0;
 int Cache::readMiss = 0;
 int Cache::writeHit = 0;
 int Cache::writeMiss = 0;
+int Cache::victimHit = 0;
 
-int FIFOCache::setSize = 0;
 
-Cache::Cache(std::shared_ptr<Ram> ram):ram(std::move(ram)){}
+Cache::Cache(std::shared_ptr<Ram> ram, IndexFunction indexFunction):
+indexFunction(indexFunction), primeSets(numSets), evictedBlock(-1), ram(std::move(ram)){
+    // largest prime not above numSets
+    auto isPrime = [](int n){
+        for(int d=2; d*d<=n; ++d){
+            if(n % d == 0) return false;
+        }
+        return n >= 2;
+    };
+    while(primeSets > 2 && !isPrime(primeSets)){
+        --primeSets;
+    }
+}
+
+// the victim cache is probed before the evicted line goes in, so a hit swaps the two
+bool Cache::swapWithVictim(Address address){
+    if(!victim){
+        return false;
+    }
+    bool found = victim->probe(address.getRamIndex());
+    if(evictedBlock != -1){
+        victim->insert(evictedBlock);
+    }
+    return found;
+}
+
+std::shared_ptr<DataBlock> Cache::getBlock(Address address){
+    bool hit;
+    CacheEntry& entry = lookup(address, hit);
+    if(hit){
+        ++readHit;
+    }else{
+        ++readMiss;
+        if(swapWithVictim(address)){
+            ++victimHit;
+        }else{
+            ram->request(address);
+        }
+    }
+    // filled on a miss, or on the first hit after a tag-only warm / restore
+    if(!entry.data){
+        entry.data = ram->getBlock(address);
+    }
+    return entry.data;
+}
 
 double Cache::getDouble(Address address){
     return getBlock(address)->data[address.getOffset()];
 }
 
+void Cache::setDouble(Address address, double value){
+    setDoubles(address, &value, 1);
+}
+
+void Cache::setDoubles(Address address, const double* values, int count){
+    bool hit;
+    CacheEntry& entry = lookup(address, hit);
+    if(hit){
+        ++writeHit;
+    }else{
+        ++writeMiss;
+        if(swapWithVictim(address)){
+            ++victimHit;
+        }else{
+            ram->request(address);
+        }
+    }
+    if(!entry.data){
+        entry.data = ram->getBlock(address);
+    }
+    for(int i=0; i<count; ++i){
+        entry.data->data[address.getOffset() + i] = values[i];
+    }
+}
 
+void Cache::accessBatch(const MemoryReference* references, int count){
+    for(int n=0; n<count; ++n){
+        bool hit;
+        lookup(references[n].address, hit);
+        if(hit){
+            ++(references[n].isWrite ? writeHit : readHit);
+            continue;
+        }
+        ++(references[n].isWrite ? writeMiss : readMiss);
+        if(swapWithVictim(references[n].address)){
+            ++victimHit;
+        }else{
+            ram->request(references[n].address);
+        }
+    }
+}
 
-RandomCache::RandomCache(std::shared_ptr<Ram> ram):
-Cache(std::move(ram)),
+bool Cache::warm(Address address){
+    bool hit;
+    lookup(address, hit);
+    if(!hit){
+        swapWithVictim(address);
+    }
+    return hit;
+}
+
+
+
+RandomCache::RandomCache(std::shared_ptr<Ram> ram, IndexFunction indexFunction):
+Cache(std::move(ram), indexFunction),
 gen(std::random_device{}()),
 distrib(0, Cache::numBlocks / Cache::numSets - 1) {
     blocks.resize(numSets);
@@ -42,141 +139,114 @@ distrib(0, Cache::numBlocks / Cache::numSets - 1) {
 
 
 // strategy: traverse all data block within a given set
-// if found, return the Data Block;
-// if not, let ram find it, and evict a random Data Block
-std::shared_ptr<DataBlock> RandomCache::getBlock(Address address){
-    int setIndex = address.getRamIndex() % Cache::numSets;
-    int tag = address.getTag();
+// if found, return the entry;
+// if not, take the first empty entry, or evict a random one
+CacheEntry& RandomCache::lookup(Address address, bool& hit){
+    int setIndex = Cache::setIndex(address);
+    int tag = tagOf(address);
     int firstEmptyIndex = -1;
     // Case 1: find in cache
     for(int i=0; i<(int)blocks[setIndex].size(); ++i){
         if(firstEmptyIndex == -1 && !blocks[setIndex][i]->valid){
             firstEmptyIndex = i;
         }else if(blocks[setIndex][i]->valid && blocks[setIndex][i]->tag == tag){
-            ++readHit;
-            return blocks[setIndex][i]->data;
+            hit = true;
+            return *blocks[setIndex][i];
         }
     }
-    ++readMiss;
+    hit = false;
     // Case 2: not found in cache but cache has empty slot
-    std::shared_ptr<DataBlock> res = ram->getBlock(address);
-    if(firstEmptyIndex != -1){
-        blocks[setIndex][firstEmptyIndex] -> valid = true;
-        blocks[setIndex][firstEmptyIndex] -> tag = tag;
-        blocks[setIndex][firstEmptyIndex] -> data = res;
-    }
     // Case 3: evict some random block
-    else{
-        int evictIndex = distrib(gen);
-        blocks[setIndex][evictIndex] -> tag = tag;
-        blocks[setIndex][evictIndex] -> data = res;
-    }
-    return res;
+    int evictIndex = firstEmptyIndex != -1 ? firstEmptyIndex : distrib(gen);
+    CacheEntry& entry = *blocks[setIndex][evictIndex];
+    evictedBlock = entry.valid ? entry.tag : -1;
+    entry.valid = true;
+    entry.tag = tag;
+    entry.data = nullptr;
+    return entry;
 }
 
-void RandomCache::setDouble(Address address, double value){
-
-    int setIndex = address.getRamIndex() % Cache::numSets;
-    int tag = address.getTag();
-    int offset = address.getOffset();
-    int firstEmptyIndex = -1;
-    // Case 1: find in cache
-    for(int i=0; i<(int)blocks[setIndex].size(); ++i){
-        if(firstEmptyIndex == -1 && !blocks[setIndex][i]->valid){
-            firstEmptyIndex = i;
-        }else if(blocks[setIndex][i]->valid && blocks[setIndex][i]->tag == tag){
-            ++writeHit;
-            blocks[setIndex][i] -> data->data[offset] = value;
-            return;
+void RandomCache::save(CheckpointWriter& writer) const{
+    writer.putString("Random");
+    for(const auto& set : blocks){
+        for(const auto& entry : set){
+            writer.put<char>(entry->valid);
+            writer.put<int>(entry->tag);
         }
     }
-    ++writeMiss;
+    std::ostringstream state;
+    state << gen;
+    writer.putString(state.str());
+}
 
-    // Case 2: not found in cache but cache has empty slot
-    if(firstEmptyIndex != -1){
-        blocks[setIndex][firstEmptyIndex] -> valid = true;
-        blocks[setIndex][firstEmptyIndex] -> tag = tag;
-        blocks[setIndex][firstEmptyIndex] -> data = ram->getBlock(address);
-        blocks[setIndex][firstEmptyIndex] -> data->data[offset] = value;
-    }
-    // Case 3: evict some random block
-    else{
-        int evictIndex = distrib(gen);
-        blocks[setIndex][evictIndex] -> tag = tag;
-        blocks[setIndex][evictIndex] -> data = ram->getBlock(address);
-        blocks[setIndex][evictIndex] -> data->data[offset] = value;
+void RandomCache::restore(CheckpointReader& reader){
+    reader.expectString("Random");
+    for(auto& set : blocks){
+        for(auto& entry : set){
+            entry->valid = reader.get<char>();
+            entry->tag = reader.get<int>();
+            entry->data = nullptr;
+        }
     }
+    std::istringstream state(reader.getString());
+    state >> gen;
 }
 
 
-LRUCache::LRUCache(std::shared_ptr<Ram> ram): Cache(std::move(ram)) {
+LRUCache::LRUCache(std::shared_ptr<Ram> ram, IndexFunction indexFunction): Cache(std::move(ram), indexFunction) {
     blocks.resize(numSets);
 }
 
-std::shared_ptr<DataBlock> LRUCache::getBlock(Address address){
-    int setIndex = address.getRamIndex() % Cache::numSets;
-    int tag = address.getTag();
+CacheEntry& LRUCache::lookup(Address address, bool& hit){
+    int setIndex = Cache::setIndex(address);
+    int tag = tagOf(address);
 
     // case 1: found in cache (cache Hit)
     for(auto it = blocks[setIndex].begin(); it!=blocks[setIndex].end(); ++it){
         if((*it)->tag == tag){
-            ++readHit;
+            hit = true;
             moveTop(blocks[setIndex], it);
-            return blocks[setIndex].front()->data;
+            return *blocks[setIndex].front();
         }
     }
 
-    ++readMiss;
-    std::shared_ptr<DataBlock> res = ram->getBlock(address);
+    hit = false;
     // case 2: not found in cache, yet cache has empty block
-    if((int)blocks[setIndex].size()< numBlocks/numSets){
-        blocks[setIndex].emplace_front(std::make_shared<CacheEntry>(true, tag, std::move(res)));
-        return blocks[setIndex].front()->data;
-    }
-
     // case 3: not found in cache, and cache does not have empty block
-    blocks[setIndex].pop_back();
-    blocks[setIndex].emplace_front(std::make_shared<CacheEntry>(true, tag, std::move(res)));
-    return blocks[setIndex].front()->data;
+    evictedBlock = -1;
+    if((int)blocks[setIndex].size() >= numBlocks/numSets){
+        evictedBlock = blocks[setIndex].back()->tag;
+        blocks[setIndex].pop_back();
+    }
+    blocks[setIndex].emplace_front(std::make_shared<CacheEntry>(true, tag, nullptr));
+    return *blocks[setIndex].front();
 }
 
-
-
-void LRUCache::setDouble(Address address, double value){
-
-    int setIndex = address.getRamIndex() % Cache::numSets;
-    int offset = address.getOffset();
-    int tag = address.getTag();
-
-    // case 1: found in cache (cache Hit)
-    for(auto it = blocks[setIndex].begin(); it!=blocks[setIndex].end(); ++it){
-        if((*it)->tag == tag){
-            ++writeHit;
-            moveTop(blocks[setIndex], it);
-            blocks[setIndex].front()->data->data[offset] = value;
-            return;
+// each set is stored from most to least recently used
+void LRUCache::save(CheckpointWriter& writer) const{
+    writer.putString("LRU");
+    for(const auto& set : blocks){
+        writer.put<int>((int)set.size());
+        for(const auto& entry : set){
+            writer.put<int>(entry->tag);
         }
     }
+}
 
-    ++writeMiss;
-    std::shared_ptr<DataBlock> res = ram->getBlock(address);
-    // case 2: not found in cache, yet cache has empty block
-    if((int)blocks[setIndex].size()< numBlocks/numSets){
-        blocks[setIndex].emplace_front(std::make_shared<CacheEntry>(true, tag, std::move(res)));
-        blocks[setIndex].front()->data->data[offset] = value;
-        return;
+void LRUCache::restore(CheckpointReader& reader){
+    reader.expectString("LRU");
+    for(auto& set : blocks){
+        set.clear();
+        int size = reader.get<int>();
+        for(int i=0; i<size; ++i){
+            set.emplace_back(std::make_shared<CacheEntry>(true, reader.get<int>(), nullptr));
+        }
     }
-
-    // case 3: not found in cache, and cache does not have empty block
-    blocks[setIndex].pop_back();
-    blocks[setIndex].emplace_front(std::make_shared<CacheEntry>(true, tag, std::move(res)));
-    blocks[setIndex].front()->data->data[offset] = value;
-
 }
 
 
-FIFOCache::FIFOCache(const std::shared_ptr<Ram>& ram): Cache(ram){
-    setSize = numBlocks/numSets;
+FIFOCache::FIFOCache(const std::shared_ptr<Ram>& ram, IndexFunction indexFunction):
+Cache(ram, indexFunction), setSize(numBlocks/numSets){
     nextFree.resize(numSets);
     std::fill(nextFree.begin(), nextFree.end(), 0);
     blocks.resize(numSets);
@@ -189,49 +259,144 @@ FIFOCache::FIFOCache(const std::shared_ptr<Ram>& ram): Cache(ram){
     }
 }
 
-std::shared_ptr<DataBlock> FIFOCache::getBlock(Address address){
+CacheEntry& FIFOCache::lookup(Address address, bool& hit){
 
-    int setIndex = address.getRamIndex() % Cache::numSets;
-    int tag = address.getTag();
+    int setIndex = Cache::setIndex(address);
+    int tag = tagOf(address);
     // Case 1: find in cache
     for(const auto & i : blocks[setIndex]){
         if(i->valid && i->tag == tag){
-            ++readHit;
-            return i->data;
+            hit = true;
+            return *i;
         }
     }
-    ++readMiss;
+    hit = false;
     // case 2/3: not found in cache, evict cache line in nextFree
-    std::shared_ptr<DataBlock> res = ram->getBlock(address);
     int evictIndex = nextFree[setIndex];
     nextFree[setIndex] = (nextFree[setIndex]+1)%setSize;
-    blocks[setIndex][evictIndex] -> valid = true;
-    blocks[setIndex][evictIndex] -> tag = tag;
-    blocks[setIndex][evictIndex] -> data = res;
-    return res;
+    CacheEntry& entry = *blocks[setIndex][evictIndex];
+    evictedBlock = entry.valid ? entry.tag : -1;
+    entry.valid = true;
+    entry.tag = tag;
+    entry.data = nullptr;
+    return entry;
 }
 
-void FIFOCache::setDouble(Address address, double value){
+void FIFOCache::save(CheckpointWriter& writer) const{
+    writer.putString("FIFO");
+    for(int i=0; i<numSets; ++i){
+        writer.put<int>(nextFree[i]);
+        for(const auto& entry : blocks[i]){
+            writer.put<char>(entry->valid);
+            writer.put<int>(entry->tag);
+        }
+    }
+}
 
-    int setIndex = address.getRamIndex() % Cache::numSets;
-    int tag = address.getTag();
-    int offset = address.getOffset();
+void FIFOCache::restore(CheckpointReader& reader){
+    reader.expectString("FIFO");
+    for(int i=0; i<numSets; ++i){
+        nextFree[i] = reader.get<int>();
+        for(auto& entry : blocks[i]){
+            entry->valid = reader.get<char>();
+            entry->tag = reader.get<int>();
+            entry->data = nullptr;
+        }
+    }
+}
 
-    // Case 1: find in cache
-    for(const auto & i : blocks[setIndex]){
-        if(i->valid && i->tag == tag){
-            ++writeHit;
-            i->data->data[offset] = value;
-            return;
+
+SkewedCache::SkewedCache(std::shared_ptr<Ram> ram, ReplacementPolicy policy):
+Cache(std::move(ram), IndexFunction::Skewed),
+policy(policy),
+gen(std::random_device{}()),
+distrib(0, Cache::numBlocks / Cache::numSets - 1),
+clock(0){
+    int ways = numBlocks / numSets;
+    if(ways > 64){
+        throw std::runtime_error("skewed indexing supports at most 64 ways");
+    }
+    blocks.resize(ways);
+    stamps.resize(ways);
+    for(int w=0; w<ways; ++w){
+        blocks[w].resize(numSets);
+        stamps[w].resize(numSets, 0);
+        for(int j=0; j<numSets; ++j){
+            blocks[w][j] = std::make_shared<CacheEntry>();
         }
     }
-    ++writeMiss;
-    // case 2/3: not found in cache, evict cache line in nextFree
-    std::shared_ptr<DataBlock> res = ram->getBlock(address);
-    int evictIndex = nextFree[setIndex];
-    nextFree[setIndex] = (nextFree[setIndex]+1)%setSize;
-    blocks[setIndex][evictIndex] -> valid = true;
-    blocks[setIndex][evictIndex] -> tag = tag;
-    blocks[setIndex][evictIndex] -> data = res;
-    blocks[setIndex][evictIndex] -> data->data[offset] = value;
-}
\ No newline at end of file
+}
+
+// strategy: probe every way at its own set
+// if not found, fill the first empty candidate, or pick one by the replacement policy
+CacheEntry& SkewedCache::lookup(Address address, bool& hit){
+    int tag = tagOf(address);
+    int ways = (int)blocks.size();
+    int candidate[64];  // set index per way, associativity above 64 is not supported
+    int firstEmptyWay = -1;
+    int oldestWay = 0;
+    ++clock;
+    for(int w=0; w<ways; ++w){
+        candidate[w] = setIndex(address, w);
+        CacheEntry& entry = *blocks[w][candidate[w]];
+        if(entry.valid && entry.tag == tag){
+            hit = true;
+            if(policy == ReplacementPolicy::LRU){
+                stamps[w][candidate[w]] = clock;
+            }
+            return entry;
+        }
+        if(firstEmptyWay == -1 && !entry.valid){
+            firstEmptyWay = w;
+        }
+        if(stamps[w][candidate[w]] < stamps[oldestWay][candidate[oldestWay]]){
+            oldestWay = w;
+        }
+    }
+    hit = false;
+    int evictWay = firstEmptyWay;
+    if(evictWay == -1){
+        evictWay = policy == ReplacementPolicy::Random ? distrib(gen) : oldestWay;
+    }
+    stamps[evictWay][candidate[evictWay]] = clock;
+    CacheEntry& entry = *blocks[evictWay][candidate[evictWay]];
+    evictedBlock = entry.valid ? entry.tag : -1;
+    entry.valid = true;
+    entry.tag = tag;
+    entry.data = nullptr;
+    return entry;
+}
+
+void SkewedCache::save(CheckpointWriter& writer) const{
+    writer.putString("Skewed");
+    writer.put<int>((int)policy);
+    writer.put<long>(clock);
+    for(int w=0; w<(int)blocks.size(); ++w){
+        for(int j=0; j<numSets; ++j){
+            writer.put<char>(blocks[w][j]->valid);
+            writer.put<int>(blocks[w][j]->tag);
+            writer.put<long>(stamps[w][j]);
+        }
+    }
+    std::ostringstream state;
+    state << gen;
+    writer.putString(state.str());
+}
+
+void SkewedCache::restore(CheckpointReader& reader){
+    reader.expectString("Skewed");
+    if(reader.get<int>() != (int)policy){
+        throw std::runtime_error("checkpoint holds a skewed cache with another replacement policy");
+    }
+    clock = reader.get<long>();
+    for(int w=0; w<(int)blocks.size(); ++w){
+        for(int j=0; j<numSets; ++j){
+            blocks[w][j]->valid = reader.get<char>();
+            blocks[w][j]->tag = reader.get<int>();
+            blocks[w][j]->data = nullptr;
+            stamps[w][j] = reader.get<long>();
+        }
+    }
+    std::istringstream state(reader.getString());
+    state >> gen;
+}
@@ -14,20 +14,52 @@
 #include "Address.h"
 #include "DataBlock.h"
 #include "Ram.h"
+#include "Checkpoint.h"
+#include "VictimCache.h"
 
 class Cache;
 
+enum class ReplacementPolicy {
+    Random,
+    FIFO,
+    LRU
+};
+
+// how a block number is mapped onto a set
+enum class IndexFunction {
+    Modulo,         // block % numSets
+    XorFold,        // upper block bits folded onto the index bits with xor
+    PrimeModulo,    // block % largest prime <= numSets, the sets above it stay unused
+    Skewed          // every way has its own xor hash (skewed-associative)
+};
+
 struct CacheEntry{
     bool valid;
-    int tag;
-    std::shared_ptr<DataBlock> data;
+    int tag;    // the whole block number, see Cache::tagOf
+    std::shared_ptr<DataBlock> data;    // null until first used after a tag-only fill
     CacheEntry():valid(false), tag(0){}
     CacheEntry(const bool valid, const int tag, const std::shared_ptr<DataBlock>& data):
     valid(valid), tag(tag), data(data){}
 };
 
 
+// a load or store of instrumented code waiting to be replayed, see Cpu::recordLoad
+struct MemoryReference{
+    Address address;
+    bool isWrite;
+};
+
+
 class Cache {
+private:
+    bool swapWithVictim(Address address);
+protected:
+    IndexFunction indexFunction;
+    int primeSets;
+    int evictedBlock;   // block pushed out by the last lookup, -1 if none
+    // find the entry holding address, or the one chosen for replacement, and update the
+    // replacement state. The returned entry already carries the new tag; hit tells which case it was.
+    virtual CacheEntry& lookup(Address address, bool& hit) = 0;
 public:
     static int numSets;
     static int numBlocks;
@@ -35,34 +67,89 @@ public:
     static int readMiss;
     static int writeHit;
     static int writeMiss;
+    static int victimHit;
     std::shared_ptr<Ram> ram;
-    explicit Cache(std::shared_ptr<Ram> ram);
-    virtual std::shared_ptr<DataBlock> getBlock(Address address) = 0;
+    std::shared_ptr<VictimCache> victim;    // optional
+    explicit Cache(std::shared_ptr<Ram> ram, IndexFunction indexFunction = IndexFunction::Modulo);
+    [[nodiscard]] IndexFunction getIndexFunction() const{ return indexFunction; }
+    [[nodiscard]] virtual ReplacementPolicy getReplacementPolicy() const = 0;
+    [[nodiscard]] inline int setIndex(Address address, int way = 0) const;
+    // tags keep the whole block number: hashed indices are not invertible,
+    // and evicted lines have to be named to the victim cache
+    [[nodiscard]] inline static int tagOf(Address address){
+        return address.getRamIndex();
+    }
+    std::shared_ptr<DataBlock> getBlock(Address address);
     double getDouble(Address address);
-    virtual void setDouble(Address address, double value) = 0;
+    void setDouble(Address address, double value);
+    // count consecutive doubles inside the block of address, one write access
+    void setDoubles(Address address, const double* values, int count);
+    // tag-only access used for fast-forwarding and tuning: no data movement and no statistics,
+    // returns whether it hit
+    bool warm(Address address);
+    // references whose data is already in Ram: the same lookups, statistics and victim / DRAM
+    // traffic as getBlock and setDouble, without touching any data
+    void accessBatch(const MemoryReference* references, int count);
+    virtual void save(CheckpointWriter& writer) const = 0;
+    virtual void restore(CheckpointReader& reader) = 0;
     virtual ~Cache() = default;
 };
 
 
+// kept in the header, it runs on every access
+int Cache::setIndex(Address address, int way) const{
+    int block = address.getRamIndex();
+    int bits = Address::indexSize;
+    switch (indexFunction) {
+        case IndexFunction::Modulo:
+            return block % numSets;
+        case IndexFunction::XorFold:
+            return (block ^ (block >> bits) ^ (block >> 2*bits)) % numSets;
+        case IndexFunction::PrimeModulo:
+            return block % primeSets;
+        case IndexFunction::Skewed: {
+            // Seznec-style skewing: xor the low index field with a hash of the bits above it,
+            // a murmur3 finalizer seeded by the way number so that every way gets its own function
+            int mask = (1 << bits) - 1;
+            int low = block & mask;
+            uint32_t high = (uint32_t)(block >> bits) ^ (0x9e3779b9u * (uint32_t)(way + 1));
+            high ^= high >> 16;
+            high *= 0x85ebca6bu;
+            high ^= high >> 13;
+            high *= 0xc2b2ae35u;
+            high ^= high >> 16;
+            return (low ^ (int)(high & (uint32_t)mask)) % numSets;
+        }
+    }
+    return block % numSets;
+}
+
+
 class RandomCache: public Cache{
 private:
     std::mt19937 gen;
     std::uniform_int_distribution<> distrib;
     std::vector<std::vector<std::shared_ptr<CacheEntry>>> blocks;
+protected:
+    CacheEntry& lookup(Address address, bool& hit) override;
 public:
-    explicit RandomCache(std::shared_ptr<Ram> ram);
-    std::shared_ptr<DataBlock> getBlock(Address address) override;
-    void setDouble(Address address, double value) override;
+    [[nodiscard]] ReplacementPolicy getReplacementPolicy() const override{ return ReplacementPolicy::Random; }
+    explicit RandomCache(std::shared_ptr<Ram> ram, IndexFunction indexFunction = IndexFunction::Modulo);
+    void save(CheckpointWriter& writer) const override;
+    void restore(CheckpointReader& reader) override;
 };
 
 
 class LRUCache: public Cache{
 private:
     std::vector<std::list<std::shared_ptr<CacheEntry>>> blocks;
+protected:
+    CacheEntry& lookup(Address address, bool& hit) override;
 public:
-    explicit LRUCache(std::shared_ptr<Ram> ram);
-    std::shared_ptr<DataBlock> getBlock(Address address) override;
-    void setDouble(Address address, double value) override;
+    [[nodiscard]] ReplacementPolicy getReplacementPolicy() const override{ return ReplacementPolicy::LRU; }
+    explicit LRUCache(std::shared_ptr<Ram> ram, IndexFunction indexFunction = IndexFunction::Modulo);
+    void save(CheckpointWriter& writer) const override;
+    void restore(CheckpointReader& reader) override;
     template<class T>
     static void moveTop(std::list<T>& list, typename std::list<T>::iterator node);
 };
@@ -80,13 +167,35 @@ class FIFOCache:public Cache{
 private:
     std::vector<std::vector<std::shared_ptr<CacheEntry>>> blocks;
     std::vector<int> nextFree;
+    int setSize;
+protected:
+    CacheEntry& lookup(Address address, bool& hit) override;
 public:
-    static int setSize;
-    explicit FIFOCache(const std::shared_ptr<Ram>& ram);
-    std::shared_ptr<DataBlock> getBlock(Address address) override;
-    void setDouble(Address address, double value) override;
+    [[nodiscard]] ReplacementPolicy getReplacementPolicy() const override{ return ReplacementPolicy::FIFO; }
+    explicit FIFOCache(const std::shared_ptr<Ram>& ram, IndexFunction indexFunction = IndexFunction::Modulo);
+    void save(CheckpointWriter& writer) const override;
+    void restore(CheckpointReader& reader) override;
 };
 
 
+// Skewed-associative cache: way w of a block lives in set setIndex(address, w), so blocks
+// that collide in one way are usually apart in the others. Since a block has a different
+// set per way, replacement works on per-entry time stamps instead of per-set order.
+class SkewedCache:public Cache{
+private:
+    ReplacementPolicy policy;
+    std::mt19937 gen;
+    std::uniform_int_distribution<> distrib;
+    std::vector<std::vector<std::shared_ptr<CacheEntry>>> blocks;   // [way][set]
+    std::vector<std::vector<long>> stamps;    // last use for LRU, fill time for FIFO
+    long clock;
+protected:
+    CacheEntry& lookup(Address address, bool& hit) override;
+public:
+    [[nodiscard]] ReplacementPolicy getReplacementPolicy() const override{ return policy; }
+    SkewedCache(std::shared_ptr<Ram> ram, ReplacementPolicy policy);
+    void save(CheckpointWriter& writer) const override;
+    void restore(CheckpointReader& reader) override;
+};
 
 #endif //PROJECT_DRAFT_CACHE_H
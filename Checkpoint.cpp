@@ -0,0 +1,175 @@
+#include "Checkpoint.h"
+#include "Cache.h"
+#include "DataBlock.h"
+#include "Ram.h"
+#include "SetSampler.h"
+#include <algorithm>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char checkpointMagic[8] = {'C', 'E', 'M', 'U', 'C', 'K', 'P', 'T'};
+
+
+void CheckpointWriter::putBytes(const void* data, size_t size){
+    size_t offset = buffer.size();
+    buffer.resize(offset + size);
+    std::memcpy(buffer.data() + offset, data, size);
+}
+
+void CheckpointWriter::putString(const std::string& value){
+    put<int>((int)value.size());
+    putBytes(value.data(), value.size());
+}
+
+void CheckpointWriter::writeTo(const std::string& path) const{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(buffer.data(), (std::streamsize)buffer.size());
+    if(!out){
+        throw std::runtime_error("cannot write checkpoint " + path);
+    }
+}
+
+
+CheckpointReader::CheckpointReader(const std::string& path): base(nullptr), cursor(nullptr), size(0){
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        throw std::runtime_error("cannot open checkpoint " + path);
+    }
+    struct stat info{};
+    if(fstat(fd, &info) != 0 || info.st_size == 0){
+        close(fd);
+        throw std::runtime_error("empty checkpoint " + path);
+    }
+    size = info.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED){
+        throw std::runtime_error("cannot map checkpoint " + path);
+    }
+    // the file is consumed front to back exactly once
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    base = cursor = static_cast<const char*>(mapping);
+}
+
+CheckpointReader::~CheckpointReader(){
+    munmap(const_cast<char*>(base), size);
+}
+
+const char* CheckpointReader::getBytes(size_t count){
+    if(count > size - (cursor - base)){
+        throw std::runtime_error("truncated checkpoint");
+    }
+    const char* res = cursor;
+    cursor += count;
+    return res;
+}
+
+std::string CheckpointReader::getString(){
+    int length = get<int>();
+    return {getBytes(length), (size_t)length};
+}
+
+void CheckpointReader::expectString(const std::string& expected){
+    std::string found = getString();
+    if(found != expected){
+        throw std::runtime_error("checkpoint holds a " + found + " cache, expected " + expected);
+    }
+}
+
+
+// header and version check shared by every reader
+static CheckpointHeader readHeader(CheckpointReader& reader, const std::string& path){
+    auto header = reader.get<CheckpointHeader>();
+    if(std::memcmp(header.magic, checkpointMagic, sizeof(checkpointMagic)) != 0 || header.version != Checkpoint::version){
+        throw std::runtime_error(path + " is not a checkpoint of this emulator version");
+    }
+    header.workload[sizeof(header.workload) - 1] = 0;
+    return header;
+}
+
+
+void Checkpoint::save(const std::string& path, const Cache& cache, const SetSampler* sampler,
+                      const std::string& workload, long references, const std::vector<uint32_t>& lastUse){
+    CheckpointHeader header{};
+    std::memcpy(header.magic, checkpointMagic, sizeof(checkpointMagic));
+    header.version = version;
+    if(workload.size() >= sizeof(header.workload)){
+        throw std::runtime_error("workload description too long for a checkpoint");
+    }
+    std::memcpy(header.workload, workload.data(), workload.size());
+    header.references = references;
+    header.ramWords = (long)lastUse.size();
+    header.numSets = Cache::numSets;
+    header.numBlocks = Cache::numBlocks;
+    header.blockSize = DataBlock::size;
+    header.indexFunction = (int)cache.getIndexFunction();
+    header.replacement = (int)cache.getReplacementPolicy();
+    header.victimEntries = cache.victim ? cache.victim->capacity : 0;
+    header.sampling = (int)(sampler ? sampler->policy : SamplingPolicy::None);
+    header.samplingRatio = sampler ? sampler->ratio : 1;
+
+    CheckpointWriter writer;
+    writer.put(header);
+    writer.putBytes(lastUse.data(), lastUse.size() * sizeof(uint32_t));
+    cache.save(writer);
+    if(cache.victim){
+        cache.victim->save(writer);
+    }
+    writer.writeTo(path);
+}
+
+CheckpointHeader Checkpoint::header(const std::string& path){
+    CheckpointReader reader(path);
+    return readHeader(reader, path);
+}
+
+bool Checkpoint::matches(const CheckpointHeader& header, const Cache& cache, const SetSampler* sampler){
+    return header.numSets == Cache::numSets && header.numBlocks == Cache::numBlocks
+        && header.blockSize == DataBlock::size
+        && header.indexFunction == (int)cache.getIndexFunction()
+        && header.replacement == (int)cache.getReplacementPolicy()
+        && header.victimEntries == (cache.victim ? cache.victim->capacity : 0)
+        && header.sampling == (int)(sampler ? sampler->policy : SamplingPolicy::None)
+        && header.samplingRatio == (sampler ? sampler->ratio : 1);
+}
+
+void Checkpoint::restore(const std::string& path, Cache& cache, const SetSampler* sampler){
+    CheckpointReader reader(path);
+    CheckpointHeader header = readHeader(reader, path);
+    if(!matches(header, cache, sampler)){
+        throw std::runtime_error("checkpoint " + path + " was taken with a different cache configuration");
+    }
+    reader.getBytes(header.ramWords * sizeof(uint32_t));
+    cache.restore(reader);
+    if(cache.victim){
+        cache.victim->restore(reader);
+    }
+}
+
+void Checkpoint::rewarm(const std::string& path, Cache& cache, const SetSampler* sampler){
+    CheckpointReader reader(path);
+    CheckpointHeader header = readHeader(reader, path);
+    // Ram rounds up to whole blocks, so its size moves a little with the block size
+    long words = std::min(header.ramWords, (long)Ram::numBlock * DataBlock::size);
+    std::vector<uint32_t> lastUse(words);
+    std::memcpy(lastUse.data(), reader.getBytes(header.ramWords * sizeof(uint32_t)), words * sizeof(uint32_t));
+
+    // a block was last used when any of its doubles was
+    std::vector<std::pair<uint32_t, int>> order;
+    for(long first=0; first<words; first+=DataBlock::size){
+        uint32_t last = *std::max_element(lastUse.begin() + first, lastUse.begin() + std::min(first + DataBlock::size, words));
+        if(last > 0){
+            order.emplace_back(last, (int)(first / DataBlock::size));
+        }
+    }
+    std::sort(order.begin(), order.end());
+    for(const auto& [last, block] : order){
+        Address address(block * DataBlock::size * 8);
+        if(!sampler || sampler->isSampled(cache.setIndex(address))){
+            cache.warm(address);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef PROJECT_DRAFT_CHECKPOINT_H
+#define PROJECT_DRAFT_CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+
+class Cache;
+class SetSampler;
+
+// accumulates a checkpoint in memory, written to disk in one go
+class CheckpointWriter {
+private:
+    std::vector<char> buffer;
+public:
+    template<class T>
+    void put(const T& value);
+    void putBytes(const void* data, size_t size);
+    void putString(const std::string& value);
+    void writeTo(const std::string& path) const;
+};
+
+template<class T>
+void CheckpointWriter::put(const T& value){
+    static_assert(std::is_trivially_copyable_v<T>, "only plain values go into a checkpoint");
+    putBytes(&value, sizeof(T));
+}
+
+
+// reads a checkpoint straight out of a read-only memory mapping of the file
+class CheckpointReader {
+private:
+    const char* base;
+    const char* cursor;
+    size_t size;
+public:
+    explicit CheckpointReader(const std::string& path);
+    CheckpointReader(const CheckpointReader&) = delete;
+    CheckpointReader& operator=(const CheckpointReader&) = delete;
+    ~CheckpointReader();
+    template<class T>
+    T get();
+    const char* getBytes(size_t count);
+    std::string getString();
+    void expectString(const std::string& expected);
+};
+
+template<class T>
+T CheckpointReader::get(){
+    static_assert(std::is_trivially_copyable_v<T>, "only plain values come out of a checkpoint");
+    T value;
+    std::memcpy(&value, getBytes(sizeof(T)), sizeof(T));
+    return value;
+}
+
+
+// everything needed to check a checkpoint against the current configuration
+struct CheckpointHeader{
+    char magic[8];
+    int version;
+    char workload[128];     // kernel and whatever else shapes its reference stream, see Checkpoint::save
+    long references;        // memory references executed before the checkpoint was taken
+    long ramWords;          // doubles covered by the recency record
+    // the cache and set sampling the tag state was taken with
+    int numSets;
+    int numBlocks;
+    int blockSize;
+    int indexFunction;
+    int replacement;
+    int victimEntries;
+    int sampling;
+    int samplingRatio;
+};
+
+// Cache state after the first references of a run, in two forms: the exact tags and
+// replacement state (RNG included) of the cache that took it, and the last reference to
+// every double of Ram. The second one rebuilds a warm cache of any other configuration
+// for the same workload, see rewarm. Ram contents are not stored, the run has to execute
+// the prefix to get back to that point of the kernel anyway and does so on Ram alone.
+class Checkpoint {
+public:
+    // bump on every layout change, a reader only accepts its own version
+    static const int version = 1;
+    static void save(const std::string& path, const Cache& cache, const SetSampler* sampler,
+                     const std::string& workload, long references, const std::vector<uint32_t>& lastUse);
+    static CheckpointHeader header(const std::string& path);
+    // whether the tag state in the checkpoint fits cache and sampler
+    static bool matches(const CheckpointHeader& header, const Cache& cache, const SetSampler* sampler);
+    static void restore(const std::string& path, Cache& cache, const SetSampler* sampler);
+    // touch every block the prefix used once, least recently used first, through the tag-only path.
+    // Gives exactly the state after the prefix for LRU without skewing or victim cache, and a warm
+    // approximation of it for the other configurations; costs one lookup per block, not per reference
+    static void rewarm(const std::string& path, Cache& cache, const SetSampler* sampler);
+};
+
+
+#endif //PROJECT_DRAFT_CHECKPOINT_H
@@ -5,18 +5,206 @@
 #include "Cpu.h"
 
 #include <utility>
+#include <algorithm>
+#include <stdexcept>
 
 long Cpu::instructionCount = 0;
+long Cpu::fastForward = 0;
+long Cpu::references = 0;
+long Cpu::crossLineAccesses = 0;
 
-Cpu::Cpu(std::shared_ptr<Cache> cache):cache(std::move(cache)){}
+Cpu::Cpu(std::shared_ptr<Cache> cache):fastForwardMode(FastForwardMode::Warm), cache(std::move(cache)){
+    batch.reserve(batchSize);
+}
+
+void Cpu::fastForwardStep(Address address, int count) const{
+    if(lastUse){
+        int word = address.getAll();
+        for(int i=0; i<count; ++i){
+            (*lastUse)[word + i] = (uint32_t)(references + 1);
+        }
+    }
+    if(fastForwardMode == FastForwardMode::Warm && (!sampler || sampler->isSampled(cache->setIndex(address)))){
+        cache->warm(address);
+    }
+    if(++references == fastForward && onFastForwardDone){
+        onFastForwardDone();
+    }
+}
+
+
+void Cpu::readBlock(Address address, double* values, int count) const{
+    int word = address.getAll();
+    if(references < fastForward){
+        fastForwardStep(address, count);
+        for(int i=0; i<count; ++i){
+            values[i] = cache->ram->getDouble(Address((word + i) << 3));
+        }
+        return;
+    }
+    int setIndex = 0;
+    if(sampler){
+        // filter unsampled sets before any cache lookup, Ram holds the live data anyway
+        setIndex = cache->setIndex(address);
+        if(!sampler->isSampled(setIndex)){
+            for(int i=0; i<count; ++i){
+                values[i] = cache->ram->getDouble(Address((word + i) << 3));
+            }
+            return;
+        }
+    }
+    int missBefore = Cache::readMiss;
+    std::shared_ptr<DataBlock> block = cache->getBlock(address);
+    for(int i=0; i<count; ++i){
+        values[i] = block->data[address.getOffset() + i];
+    }
+    if(sampler){
+        sampler->record(setIndex, false, Cache::readMiss == missBefore);
+    }
+}
+
+void Cpu::writeBlock(Address address, const double* values, int count) const{
+    int word = address.getAll();
+    if(references < fastForward){
+        for(int i=0; i<count; ++i){
+            cache->ram->setDouble(Address((word + i) << 3), values[i]);
+        }
+        fastForwardStep(address, count);
+        return;
+    }
+    int setIndex = 0;
+    if(sampler){
+        setIndex = cache->setIndex(address);
+        if(!sampler->isSampled(setIndex)){
+            for(int i=0; i<count; ++i){
+                cache->ram->setDouble(Address((word + i) << 3), values[i]);
+            }
+            return;
+        }
+    }
+    int missBefore = Cache::writeMiss;
+    cache->setDoubles(address, values, count);
+    if(sampler){
+        sampler->record(setIndex, true, Cache::writeMiss == missBefore);
+    }
+}
+
+void Cpu::translate(Address address) const{
+    int walk[4];
+    int count = tlb->translate(address, walk);
+    for(int i=0; i<count; ++i){
+        double entry;
+        int missBefore = Cache::readMiss;
+        readBlock(Address(walk[i]), &entry, 1);
+        tlb->walkMisses += Cache::readMiss != missBefore;
+    }
+}
 
 
 double Cpu::loadDouble(Address address) const{
     ++instructionCount;
-    return cache->getDouble(address);
+    double value;
+    if(tlb){
+        translate(address);
+    }
+    readBlock(address, &value, 1);
+    return value;
 }
 void Cpu::storeDouble(Address address, double value) const{
     ++instructionCount;
-    cache->setDouble(address, value);
+    if(tlb){
+        translate(address);
+    }
+    writeBlock(address, &value, 1);
 }
 
+// split the access at block boundaries, each piece is one memory reference
+VectorRegister Cpu::loadVector(Address address, int width) const{
+    ++instructionCount;
+    VectorRegister res{{}, width};
+    int word = address.getAll();
+    int done = 0;
+    while(done < width){
+        Address piece((word + done) << 3);
+        int count = std::min(width - done, DataBlock::size - piece.getOffset());
+        if(tlb){
+            translate(piece);
+        }
+        readBlock(piece, res.lane + done, count);
+        done += count;
+    }
+    if(Address((word + width - 1) << 3).getRamIndex() != address.getRamIndex()){
+        ++crossLineAccesses;
+    }
+    return res;
+}
+
+void Cpu::storeVector(Address address, const VectorRegister& value) const{
+    ++instructionCount;
+    int word = address.getAll();
+    int done = 0;
+    while(done < value.width){
+        Address piece((word + done) << 3);
+        int count = std::min(value.width - done, DataBlock::size - piece.getOffset());
+        if(tlb){
+            translate(piece);
+        }
+        writeBlock(piece, value.lane + done, count);
+        done += count;
+    }
+    if(Address((word + value.width - 1) << 3).getRamIndex() != address.getRamIndex()){
+        ++crossLineAccesses;
+    }
+}
+
+VectorRegister Cpu::broadcastDouble(Address address, int width) const{
+    ++instructionCount;
+    VectorRegister res{{}, width};
+    if(tlb){
+        translate(address);
+    }
+    readBlock(address, res.lane, 1);
+    for(int i=1; i<width; ++i){
+        res.lane[i] = res.lane[0];
+    }
+    return res;
+}
+
+VectorRegister Cpu::fmaVector(const VectorRegister& value1, const VectorRegister& value2,
+                              const VectorRegister& value3){
+    if(value2.width != value1.width || value3.width != value1.width){
+        throw std::runtime_error("fma operands must have the same vector width");
+    }
+    ++instructionCount;
+    VectorRegister res{{}, value1.width};
+    for(int i=0; i<value1.width; ++i){
+        res.lane[i] = value1.lane[i] * value2.lane[i] + value3.lane[i];
+    }
+    return res;
+}
+
+// Ram already holds the values, a replayed store writes back what is there
+void Cpu::flush(){
+    if(!tlb && !sampler && references >= fastForward){
+        if(cache->ram->dram){
+            // the DRAM model is clocked by instructionCount, misses must arrive one instruction apart
+            for(const auto& reference : batch){
+                ++instructionCount;
+                cache->accessBatch(&reference, 1);
+            }
+        }else{
+            instructionCount += (long)batch.size();
+            cache->accessBatch(batch.data(), (int)batch.size());
+        }
+        batch.clear();
+        return;
+    }
+    for(const auto& reference : batch){
+        if(reference.isWrite){
+            storeDouble(reference.address, cache->ram->getDouble(reference.address));
+        }else{
+            (void)loadDouble(reference.address);
+        }
+    }
+    batch.clear();
+}
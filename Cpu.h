@@ -7,15 +7,84 @@
 
 #include "Address.h"
 #include "Cache.h"
+#include "SetSampler.h"
+#include "Tlb.h"
 #include <memory>
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+enum class FastForwardMode {
+    Warm,   // functional run that keeps cache tags warm through the tag-only path
+    Skip    // functional run on Ram only, the cache state comes from a checkpoint afterwards
+};
+
+// a SIMD register of up to Cpu::maxVectorWidth doubles
+struct VectorRegister{
+    double lane[8];
+    int width;
+};
 
 class Cpu {
+private:
+    std::vector<MemoryReference> batch;
+    inline void record(Address address, bool isWrite){
+        batch.push_back({address, isWrite});
+        // while fast-forwarding, a checkpoint may be restored at an exact reference, so replay at once
+        if((int)batch.size() == batchSize || references < fastForward){
+            flush();
+        }
+    }
+    void fastForwardStep(Address address, int count) const;
+    // one memory reference: count doubles starting at address, all inside one block
+    void readBlock(Address address, double* values, int count) const;
+    void writeBlock(Address address, const double* values, int count) const;
+    // TLB lookup for one reference, a page walk reads its table entries through the cache
+    void translate(Address address) const;
 public:
+    static const int maxVectorWidth = 8;
+    static const int batchSize = 4096;
     static long instructionCount;
+    // vector accesses that straddle two blocks and so cost two references
+    static long crossLineAccesses;
+    // memory references executed functionally before detailed simulation starts
+    static long fastForward;
+    static long references;
+    FastForwardMode fastForwardMode;
+    // runs once, right after the last fast-forwarded reference
+    std::function<void()> onFastForwardDone;
     explicit Cpu(std::shared_ptr<Cache> cache);
     std::shared_ptr<Cache> cache;
+    // optional, when set only accesses to sampled sets reach the cache
+    std::shared_ptr<SetSampler> sampler;
+    // optional, when set every data reference is translated first
+    std::shared_ptr<Tlb> tlb;
+    // optional, when set the fast-forward writes the number of the last reference to each
+    // double of Ram into it (0: never touched), for Checkpoint::save
+    std::shared_ptr<std::vector<uint32_t>> lastUse;
     [[nodiscard]] double loadDouble(Address address) const;
     void storeDouble(Address address, double value) const;
+    // width consecutive doubles, one instruction; narrower widths act as masked tails
+    [[nodiscard]] VectorRegister loadVector(Address address, int width) const;
+    void storeVector(Address address, const VectorRegister& value) const;
+    // load one double and copy it into every lane, one instruction
+    [[nodiscard]] VectorRegister broadcastDouble(Address address, int width) const;
+    // value1 * value2 + value3 lane by lane, one instruction
+    static VectorRegister fmaVector(const VectorRegister& value1, const VectorRegister& value2,
+                                    const VectorRegister& value3);
+    // for instrumented code (SimArray): the value is read from or written to Ram right away,
+    // the reference is queued and replayed through the cache in batches
+    inline double recordLoad(Address address){
+        record(address, false);
+        return cache->ram->getDouble(address);
+    }
+    inline void recordStore(Address address, double value){
+        cache->ram->setDouble(address, value);
+        record(address, true);
+    }
+    // replay the queued references, in program order; without TLB, sampler or a pending
+    // fast-forward the batch skips the per-reference path (one call, or one per reference with DRAM)
+    void flush();
     inline static double addDouble(double value1, double value2){
         ++instructionCount;
         return value1 + value2;
@@ -0,0 +1,182 @@
+#include "Dram.h"
+#include <algorithm>
+#include <climits>
+#include <sstream>
+#include <stdexcept>
+
+Dram::Dram(const DramConfig& config, int blockBytes, const long* clock):
+config(config), queued(0), now(0), firstArrival(-1), lastCompletion(0),
+columnsPerRow(config.rowBytes / blockBytes), clock(clock),
+requests(0), rowHits(0), rowMisses(0), bankConflicts(0), totalLatency(0), queueFullStalls(0), stallCycles(0){
+    if(config.channels < 1 || config.ranks < 1 || config.banks < 1 || columnsPerRow < 1 || config.queueDepth < 1){
+        throw std::runtime_error("DRAM needs at least one channel, rank, bank, queue slot and a row of one block");
+    }
+    // the row has no fixed width, it has to be the most significant field
+    std::stringstream spec(config.mapping);
+    std::string name;
+    std::vector<Field> msbFirst;
+    while(std::getline(spec, name, ':')){
+        if(name == "row") msbFirst.push_back(Field::Row);
+        else if(name == "rank") msbFirst.push_back(Field::Rank);
+        else if(name == "bank") msbFirst.push_back(Field::Bank);
+        else if(name == "channel") msbFirst.push_back(Field::Channel);
+        else if(name == "column") msbFirst.push_back(Field::Column);
+        else throw std::runtime_error("unknown DRAM address field " + name);
+    }
+    for(Field field : {Field::Row, Field::Rank, Field::Bank, Field::Channel, Field::Column}){
+        if(std::count(msbFirst.begin(), msbFirst.end(), field) != 1){
+            throw std::runtime_error("DRAM mapping must name row, rank, bank, channel and column once each");
+        }
+    }
+    if(msbFirst.front() != Field::Row){
+        throw std::runtime_error("DRAM mapping must start with the row");
+    }
+    fields.assign(msbFirst.rbegin(), msbFirst.rend() - 1);
+    queue.resize(config.queueDepth);
+    bankState.resize(config.channels * config.ranks * config.banks, Bank{-1, 0});
+    busFreeAt.resize(config.channels, 0);
+}
+
+void Dram::decode(long block, Request& request) const{
+    long rest = block;
+    int channel = 0, rank = 0, bank = 0;
+    for(Field field : fields){
+        switch (field) {
+            case Field::Column:
+                rest /= columnsPerRow; break;
+            case Field::Channel:
+                channel = (int)(rest % config.channels); rest /= config.channels; break;
+            case Field::Rank:
+                rank = (int)(rest % config.ranks); rest /= config.ranks; break;
+            case Field::Bank:
+                bank = (int)(rest % config.banks); rest /= config.banks; break;
+            case Field::Row:
+                break;
+        }
+    }
+    request.channel = channel;
+    request.bank = (channel * config.ranks + rank) * config.banks + bank;
+    request.row = rest;
+}
+
+bool Dram::issueNext(long limit){
+    // earliest moment any queued request can issue
+    long issue = -1;
+    for(int i=0; i<queued; ++i){
+        long ready = std::max(queue[i].arrival, bankState[queue[i].bank].readyAt);
+        if(issue == -1 || ready < issue){
+            issue = ready;
+        }
+    }
+    issue = std::max(issue, now);
+    if(issue > limit){
+        return false;
+    }
+
+    // FR-FCFS: the oldest ready row hit, otherwise the oldest ready request
+    int pick = -1;
+    for(int i=0; i<queued; ++i){
+        const Bank& bank = bankState[queue[i].bank];
+        if(queue[i].arrival > issue || bank.readyAt > issue){
+            continue;
+        }
+        if(bank.openRow == queue[i].row){
+            pick = i;
+            break;
+        }
+        if(pick == -1){
+            pick = i;
+        }
+    }
+
+    Request request = queue[pick];
+    Bank& bank = bankState[request.bank];
+    long latency;
+    if(bank.openRow == request.row){
+        ++rowHits;
+        latency = config.tCAS;
+    }else if(bank.openRow == -1){
+        ++rowMisses;
+        latency = config.tRCD + config.tCAS;
+    }else{
+        ++bankConflicts;
+        latency = config.tRP + config.tRCD + config.tCAS;
+    }
+    long start = std::max(issue + latency, busFreeAt[request.channel]);
+    long done = start + config.tBurst;
+    busFreeAt[request.channel] = done;
+    if(config.policy == RowPolicy::Open){
+        bank.openRow = request.row;
+        bank.readyAt = start;   // further column reads to the open row pipeline behind this one
+    }else{
+        bank.openRow = -1;
+        bank.readyAt = done + config.tRP;
+    }
+    totalLatency += done - request.arrival;
+    lastCompletion = std::max(lastCompletion, done);
+    now = issue;
+
+    // keep the queue in arrival order
+    for(int i=pick; i<queued-1; ++i){
+        queue[i] = queue[i+1];
+    }
+    --queued;
+    return true;
+}
+
+void Dram::request(long block){
+    // the cpu clock does not know about stalls, shift it by the stall cycles so far
+    long arrival = *clock + stallCycles;
+    if(firstArrival == -1){
+        firstArrival = arrival;
+    }
+    // issue whatever could have gone out before this arrival
+    while(queued > 0 && issueNext(arrival)){
+    }
+    // a full queue stalls the cpu until the next request issues and frees a slot
+    if(queued == config.queueDepth){
+        ++queueFullStalls;
+        issueNext(LONG_MAX);
+        if(now > arrival){
+            stallCycles += now - arrival;
+            arrival = now;
+        }
+    }
+    Request& slot = queue[queued++];
+    slot.arrival = arrival;
+    decode(block, slot);
+    ++requests;
+}
+
+void Dram::drain(){
+    while(queued > 0){
+        issueNext(LONG_MAX);
+    }
+}
+
+void Dram::reset(){
+    queued = 0;
+    std::fill(bankState.begin(), bankState.end(), Bank{-1, 0});
+    std::fill(busFreeAt.begin(), busFreeAt.end(), 0);
+    now = 0;
+    firstArrival = -1;
+    lastCompletion = 0;
+    requests = rowHits = rowMisses = bankConflicts = totalLatency = queueFullStalls = stallCycles = 0;
+}
+
+double Dram::rowHitRate() const{
+    return requests ? (double)rowHits / (double)requests : 0.0;
+}
+
+double Dram::averageLatency() const{
+    return requests ? (double)totalLatency / (double)requests : 0.0;
+}
+
+// bytes per cpu cycle times cycles per ns
+double Dram::bandwidthGBs(int blockBytes) const{
+    long cycles = lastCompletion - firstArrival;
+    if(requests == 0 || cycles <= 0){
+        return 0.0;
+    }
+    return (double)requests * blockBytes / (double)cycles * config.cpuGHz;
+}
@@ -0,0 +1,80 @@
+#ifndef PROJECT_DRAFT_DRAM_H
+#define PROJECT_DRAFT_DRAM_H
+
+#include <string>
+#include <vector>
+
+enum class RowPolicy {
+    Open,     // keep the row open after an access, later hits skip the activate
+    Closed    // precharge right after every access
+};
+
+struct DramConfig{
+    int channels = 1;
+    int ranks = 1;
+    int banks = 8;
+    int rowBytes = 8192;
+    RowPolicy policy = RowPolicy::Open;
+    // address fields from most to least significant bit, the row takes what is left
+    std::string mapping = "row:rank:bank:channel:column";
+    int queueDepth = 32;
+    // timings in cpu cycles, the cpu runs one instruction per cycle
+    int tCAS = 42;
+    int tRCD = 42;
+    int tRP = 42;
+    int tBurst = 8;     // one block on the data bus
+    double cpuGHz = 3.0;
+};
+
+// Timing model of the DRAM behind Ram. Misses arrive with the current instruction count (plus
+// the cycles stalled on a full queue so far) as time stamp and wait in a fixed-size request queue; an FR-FCFS scheduler (row hits first,
+// then oldest) issues them to banks as they become ready. Queue, banks and buses are flat
+// arrays allocated once, nothing is allocated per request.
+class Dram {
+private:
+    enum class Field { Row, Rank, Bank, Channel, Column };
+    struct Request{
+        long arrival;
+        int bank;       // flat channel/rank/bank index
+        int channel;
+        long row;
+    };
+    struct Bank{
+        long openRow;   // -1 when precharged
+        long readyAt;
+    };
+    DramConfig config;
+    std::vector<Field> fields;      // least significant first
+    std::vector<Request> queue;     // slots [0, queued) are live, in arrival order
+    int queued;
+    std::vector<Bank> bankState;
+    std::vector<long> busFreeAt;
+    long now;
+    long firstArrival;
+    long lastCompletion;
+    int columnsPerRow;
+    void decode(long block, Request& request) const;
+    // issue one queued request unless none can go out by limit
+    bool issueNext(long limit);
+public:
+    const long* clock;      // arrival time source, usually &Cpu::instructionCount
+    long requests;
+    long rowHits;
+    long rowMisses;         // row buffer was empty
+    long bankConflicts;     // another row was open and had to be closed first
+    long totalLatency;
+    long queueFullStalls;
+    long stallCycles;       // cpu cycles lost waiting for a queue slot
+    Dram(const DramConfig& config, int blockBytes, const long* clock);
+    void request(long block);
+    // issue everything still queued
+    void drain();
+    void reset();
+    [[nodiscard]] double rowHitRate() const;
+    [[nodiscard]] double averageLatency() const;
+    [[nodiscard]] double bandwidthGBs(int blockBytes) const;
+    [[nodiscard]] const DramConfig& getConfig() const{ return config; }
+};
+
+
+#endif //PROJECT_DRAFT_DRAM_H
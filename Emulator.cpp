@@ -0,0 +1,502 @@
+#include "Emulator.h"
+#include <iostream>
+#include <cmath>
+#include <climits>
+#include <stdexcept>
+#include <sstream>
+#include "Checkpoint.h"
+#include "SimArray.h"
+
+using namespace std;
+
+int cacheSize;
+int dataBlockSize;
+int associativity;
+ReplacementPolicy replacement;
+IndexFunction indexFunction;
+int victimEntries;
+int vectorWidth;
+bool tlbEnabled;
+PageSize pageSize;
+std::vector<TlbLevelConfig> tlbLevels;
+int pwcEntries;
+bool dramEnabled;
+DramConfig dramConfig;
+AlgorithmPolicy algorithm;
+int dimension;
+int blockingFactor;
+SamplingPolicy sampling;
+int samplingRatio;
+long warmupReferences;
+std::string checkpointSavePath;
+std::string checkpointLoadPath;
+bool checkpointTagsRestored;
+
+shared_ptr<Ram> ram;
+shared_ptr<Cache> cache;
+shared_ptr<Cpu> cpu;
+shared_ptr<SetSampler> sampler;
+shared_ptr<Tlb> tlb;
+
+// default configuration, parseInput starts from it
+void defaultSettings(){
+    cacheSize = 524288;
+    dataBlockSize = 64;   // first /8 then*8? keep it as a multiple of 8
+    associativity = 2;
+    replacement = ReplacementPolicy::LRU;
+    indexFunction = IndexFunction::Modulo;
+    victimEntries = 0;
+    vectorWidth = 1;
+    tlbEnabled = false;
+    pageSize = PageSize::Page4K;
+    tlbLevels = {{64, 4}, {1536, 12}};    // L1 dTLB and L2 STLB
+    pwcEntries = 32;
+    dramEnabled = false;
+    dramConfig = DramConfig();
+    algorithm = AlgorithmPolicy::mxm_block;  // [TODO] change back to mxm_block back !
+    dimension = 480;
+    blockingFactor = 32;
+    sampling = SamplingPolicy::None;
+    samplingRatio = 1;
+    warmupReferences = 0;
+    checkpointSavePath.clear();
+    checkpointLoadPath.clear();
+}
+
+
+void resetStatistics(){
+    Cpu::instructionCount = 0;
+    Cache::readHit = Cache::readMiss = Cache::writeHit = Cache::writeMiss = 0;
+    Cache::victimHit = 0;
+    Cpu::crossLineAccesses = 0;
+    if(tlb){
+        tlb->resetStatistics();
+    }
+    if(ram && ram->dram){
+        ram->dram->reset();
+    }
+}
+
+
+// cache for the current configuration, victim buffer included
+shared_ptr<Cache> makeCache(const shared_ptr<Ram>& backing){
+    shared_ptr<Cache> res;
+    if(indexFunction == IndexFunction::Skewed){
+        res = make_shared<SkewedCache>(backing, replacement);
+    }else{
+        switch (replacement) {
+            case ReplacementPolicy::Random:
+                res = make_shared<RandomCache>(backing, indexFunction); break;
+            case ReplacementPolicy::LRU:
+                res = make_shared<LRUCache>(backing, indexFunction); break;
+            case ReplacementPolicy::FIFO:
+                res = make_shared<FIFOCache>(backing, indexFunction); break;
+        }
+    }
+    if(victimEntries > 0){
+        res->victim = make_shared<VictimCache>(victimEntries);
+    }
+    return res;
+}
+
+
+// everything that decides the reference stream up to a checkpoint, the cache aside
+static std::string workloadKey(){
+    const char* names[] = {"daxpy", "mxm", "mxm_block", "mxm_sim"};
+    std::ostringstream res;
+    res << names[(int)algorithm] << " d=" << dimension;
+    if(algorithm == AlgorithmPolicy::mxm_block){
+        res << " f=" << blockingFactor;
+    }
+    if(vectorWidth > 1){
+        // vectors that straddle two blocks cost two references
+        res << " vw=" << vectorWidth;
+    }
+    if(vectorWidth > 1 || tlbEnabled){
+        // the page table starts at the end of Ram, which is rounded up to whole blocks
+        res << " b=" << dataBlockSize;
+    }
+    if(tlbEnabled){
+        // page walks are references too
+        const char* pageNames[] = {"4K", "2M", "1G"};
+        res << " tlb=" << pageNames[(int)pageSize] << " pwc=" << pwcEntries;
+        for(const TlbLevelConfig& level : tlbLevels){
+            res << " " << level.entries << ":" << level.ways;
+        }
+    }
+    return res.str();
+}
+
+
+void initializeEmulator(){
+
+    // reset statistics of any previous run
+    resetStatistics();
+
+    // initialize Data Block
+    DataBlock::size = dataBlockSize / sz;   // suppose divisible!
+
+    // initialize Cache
+    Cache::numBlocks = cacheSize / dataBlockSize;  // suppose divisible!
+    Cache::numSets = Cache::numBlocks / associativity;  // suppose divisible!
+
+    // initialize Address
+    Address::indexSize = std::ceil(std::log(Cache::numSets) / std::log(2));
+    Address::offsetSize = std::ceil(std::log(DataBlock::size) / std::log(2));
+    Address::tagSize = addressSize - Address::indexSize - Address::offsetSize;
+
+
+
+    // initialize Ram
+    if(algorithm==AlgorithmPolicy::daxpy){
+        Ram::numBlock = ceil(3.0 * dimension / DataBlock::size);
+    }else{
+        Ram::numBlock = ceil(3.0 * dimension * dimension / DataBlock::size);
+    }
+    // the page table goes right after the data
+    long dataBytes = (long)Ram::numBlock * dataBlockSize;
+    if(tlbEnabled){
+        long tableEnd = Tlb::pageTableEnd(dataBytes, pageSize);
+        if(tableEnd > INT32_MAX){
+            throw std::runtime_error("data and page table do not fit into the 31-bit address space");
+        }
+        Ram::numBlock = (int)((tableEnd + dataBlockSize - 1) / dataBlockSize);
+    }
+
+    ram = make_shared<Ram>();
+    if(dramEnabled){
+        // one block per burst at one beat (8 bytes) per cycle
+        dramConfig.tBurst = dataBlockSize / sz;
+        ram->dram = make_shared<Dram>(dramConfig, dataBlockSize, &Cpu::instructionCount);
+    }
+
+    cache = makeCache(ram);
+
+    if(vectorWidth < 1 || vectorWidth > Cpu::maxVectorWidth){
+        throw std::runtime_error("vector width must be between 1 and 8 doubles");
+    }
+
+    cpu = make_shared<Cpu>(cache);
+
+    tlb = nullptr;
+    if(tlbEnabled){
+        tlb = make_shared<Tlb>(pageSize, tlbLevels, pwcEntries, dataBytes);
+        cpu->tlb = tlb;
+    }
+
+    // sampling every set is the same as a full run, skip the filter then
+    sampler = nullptr;
+    if(sampling != SamplingPolicy::None && samplingRatio > 1){
+        if(indexFunction == IndexFunction::Skewed){
+            throw std::runtime_error("set sampling needs one set per block, it cannot be combined with skewed indexing");
+        }
+        if(victimEntries > 0){
+            throw std::runtime_error("the victim cache is shared by all sets, it cannot be combined with set sampling");
+        }
+        sampler = make_shared<SetSampler>(sampling, samplingRatio);
+        cpu->sampler = sampler;
+    }
+
+    // fast-forward: warm the caches tag-only, or skip straight to a checkpoint,
+    // then start detailed statistics from zero
+    Cpu::references = 0;
+    Cpu::fastForward = warmupReferences;
+    if(!checkpointSavePath.empty() && (warmupReferences <= 0 || !checkpointLoadPath.empty())){
+        throw std::runtime_error("-cs saves the cache after the -w warm-up, it needs -w and cannot be combined with -cl");
+    }
+    if(!checkpointSavePath.empty() && warmupReferences >= UINT32_MAX){
+        throw std::runtime_error("checkpoints hold reference numbers as 32 bits, use a shorter -w");
+    }
+    checkpointTagsRestored = false;
+    if(!checkpointLoadPath.empty()){
+        CheckpointHeader header = Checkpoint::header(checkpointLoadPath);
+        if(workloadKey() != header.workload){
+            throw std::runtime_error("checkpoint " + checkpointLoadPath + " was taken for another workload ("
+                                     + header.workload + ")");
+        }
+        // the prefix only runs on Ram, the cache comes out of the checkpoint afterwards
+        Cpu::fastForward = header.references;
+        cpu->fastForwardMode = FastForwardMode::Skip;
+        checkpointTagsRestored = Checkpoint::matches(header, *cache, sampler.get());
+        cpu->onFastForwardDone = [](){
+            if(checkpointTagsRestored){
+                Checkpoint::restore(checkpointLoadPath, *cache, sampler.get());
+            }else{
+                Checkpoint::rewarm(checkpointLoadPath, *cache, sampler.get());
+            }
+            resetStatistics();
+        };
+    }else{
+        cpu->fastForwardMode = FastForwardMode::Warm;
+        if(!checkpointSavePath.empty()){
+            cpu->lastUse = make_shared<std::vector<uint32_t>>((size_t)Ram::numBlock * DataBlock::size, 0);
+        }
+        cpu->onFastForwardDone = [](){
+            if(!checkpointSavePath.empty()){
+                Checkpoint::save(checkpointSavePath, *cache, sampler.get(), workloadKey(), Cpu::references, *cpu->lastUse);
+                cpu->lastUse = nullptr;
+            }
+            resetStatistics();
+        };
+    }
+
+}
+
+// address tables of the configured kernel, filled by prepareKernel
+static std::vector<Address> vectorA, vectorB, vectorC;
+static std::vector<std::vector<Address>> matrixA, matrixB, matrixC;
+static int daxpyValue;      // what a is filled with, b holds twice that
+static const double daxpyD = 3;
+
+// returns the value a is filled with, b holds twice that
+int constructVectors(std::vector<Address>& a, std::vector<Address>& b, std::vector<Address>& c){
+    int address = 0;
+    for(int i=0; i<dimension; ++i){
+        a[i] = Address(address);
+        b[i] = Address(sz*dimension+address);
+        c[i] = Address(2*sz*dimension+address);
+        address += sz;
+    }
+
+    // insert some value in ram
+    int value = 1;
+    for(int i=0; i<dimension; ++i){
+        ram->setDouble(a[i], value);
+        ram->setDouble(b[i], 2*value);
+        ram->setDouble(c[i], 0);
+    }
+    cout << "Value initialized. " << endl;
+    return value;
+}
+
+void emulateDaxpy(){
+    // emulate c = a*D + b
+    const std::vector<Address>& a = vectorA, & b = vectorB, & c = vectorC;
+
+    // put a random D value in register
+    double register0 = daxpyD, register1, register2, register3, register4;
+
+    // Run the daxpy
+    for(int i=0; i<dimension; ++i){
+        register1 = cpu->loadDouble(Address(a[i]));
+        register2 = cpu->Cpu::multDouble(register0, register1);
+        register3 = cpu->loadDouble(Address(b[i]));
+        register4 = cpu->Cpu::addDouble(register2, register3);
+        cpu ->storeDouble(Address(c[i]), register4);
+    }
+}
+
+void emulateDaxpyVector(){
+    // emulate c = a*D + b, vectorWidth elements per instruction
+    const std::vector<Address>& a = vectorA, & b = vectorB, & c = vectorC;
+
+    VectorRegister register0, register1, register2, register3;
+
+    // the tail runs as a narrower (masked) vector
+    for(int i=0; i<dimension; i+=vectorWidth){
+        int width = min(vectorWidth, dimension - i);
+        // put the same D value in every lane of a register as wide as the operands
+        register0.width = width;
+        for(int l=0; l<width; ++l){
+            register0.lane[l] = daxpyD;
+        }
+        register1 = cpu->loadVector(a[i], width);
+        register2 = cpu->loadVector(b[i], width);
+        register3 = Cpu::fmaVector(register0, register1, register2);
+        cpu->storeVector(c[i], register3);
+    }
+}
+
+
+
+void constructMatrix(std::vector<std::vector<Address>>& a, std::vector<std::vector<Address>>& b,
+                     std::vector<std::vector<Address>>& c){
+
+    int address = 0;
+    for(int i=0; i<dimension; ++i){
+        for(int j=0; j<dimension; ++j){
+            a[i][j] = Address(address);
+            b[i][j] = Address(sz*dimension*dimension + address);
+            c[i][j] = Address(2*sz*dimension*dimension + address);
+            address += sz;
+        }
+    }
+
+    // insert some value in ram
+    int value = 1;
+    for(int i=0; i<dimension; ++i){
+        for(int j=0; j<dimension; ++j){
+            ram->setDouble(a[i][j], value);
+            ram->setDouble(b[i][j], value);
+            ram->setDouble(c[i][j], 0);
+            // increase value if necessary
+        }
+    }
+    cout << "Value initialized. " << endl;
+}
+
+
+void emulateMxm(){
+
+    // emulate C = A * B
+    const std::vector<std::vector<Address>>& a = matrixA, & b = matrixB, & c = matrixC;
+
+    // run naive mxm
+    double register1, register2, register3, register4;
+    for(int i=0; i<dimension; ++i){
+        for(int j=0; j<dimension; ++j){
+            register1 = 0.0;
+            for(int k=0; k<dimension; ++k){
+                register2 = cpu->loadDouble(a[i][k]);
+                register3 = cpu->loadDouble(b[k][j]);
+                register4 = cpu->multDouble(register2, register3);
+                register1 = cpu->addDouble(register1, register4);
+            }
+            cpu->storeDouble(c[i][j], register1);
+        }
+    }
+
+}
+
+void emulateMxmBlock(){
+
+
+
+    // emulate C = A * B
+    const std::vector<std::vector<Address>>& a = matrixA, & b = matrixB, & c = matrixC;
+
+    // run block mxm
+    double register1, register2, register3, register4, tmp;
+    int i, j, k, jj, kk;
+    for(jj=0; jj<dimension; jj+=blockingFactor){
+        for(kk=0; kk<dimension; kk+=blockingFactor){
+            for(i=0; i<dimension; ++i){
+                for(j=jj; j<min(jj+blockingFactor, dimension); ++j){
+                    register1 = cpu->loadDouble(c[i][j]);  // Load directly to register1
+//                    if((int)register1%32!=0 ){
+//                        int v1 = cpu->loadDouble(c[i][j]);
+//                        int v2 = ram->getDouble(c[i][j]);
+//                        cout << v1 << " " << v2 << endl;
+//                    }
+                    for(k=kk; k<min(kk+blockingFactor, dimension); ++k){
+                        register2 = cpu->loadDouble(a[i][k]);
+                        register3 = cpu->loadDouble(b[k][j]);
+                        register4 = cpu->multDouble(register2, register3);
+                        register1 = cpu->addDouble(register1, register4);
+                    }
+                    cpu->storeDouble(c[i][j], register1);  // Store from register1
+//                    if((int)register1%32!=0  || (int)(ram->getDouble(c[i][j]))%32!=0 ){
+//                        cout << register1 << endl;
+//                    }
+                }
+            }
+        }
+    }
+
+}
+
+void emulateMxmBlockVector(){
+
+    // emulate C = A * B with the j loop vectorized: a[i][k] is broadcast,
+    // rows of b and c are loaded vectorWidth elements at a time
+    const std::vector<std::vector<Address>>& a = matrixA, & b = matrixB, & c = matrixC;
+
+    VectorRegister register1, register2, register3;
+    int i, j, k, jj, kk;
+    for(jj=0; jj<dimension; jj+=blockingFactor){
+        for(kk=0; kk<dimension; kk+=blockingFactor){
+            int jEnd = min(jj+blockingFactor, dimension);
+            for(i=0; i<dimension; ++i){
+                for(j=jj; j<jEnd; j+=vectorWidth){
+                    int width = min(vectorWidth, jEnd - j);
+                    register1 = cpu->loadVector(c[i][j], width);
+                    for(k=kk; k<min(kk+blockingFactor, dimension); ++k){
+                        register2 = cpu->broadcastDouble(a[i][k], width);
+                        register3 = cpu->loadVector(b[k][j], width);
+                        register1 = Cpu::fmaVector(register2, register3, register1);
+                    }
+                    cpu->storeVector(c[i][j], register1);
+                }
+            }
+        }
+    }
+}
+
+void emulateMxmSimArray(){
+
+    // the naive mxm written as plain C++ over SimArrays, same layout as constructMatrix;
+    // loads and stores reach the cache in batches, arithmetic is not counted
+    SimArray<double, 2> a(*cpu, 0, {dimension, dimension});
+    SimArray<double, 2> b(*cpu, a.end(), {dimension, dimension});
+    SimArray<double, 2> c(*cpu, b.end(), {dimension, dimension});
+
+    for(int i=0; i<dimension; ++i){
+        for(int j=0; j<dimension; ++j){
+            double sum = 0.0;
+            for(int k=0; k<dimension; ++k){
+                // one statement per load keeps the reference order fixed, as in emulateMxm
+                double aik = a[i][k];
+                double bkj = b[k][j];
+                sum += aik * bkj;
+            }
+            c[i][j] = sum;
+        }
+    }
+    cpu->flush();
+}
+
+
+void prepareKernel(){
+    switch (algorithm) {
+        case AlgorithmPolicy::daxpy:
+            vectorA.assign(dimension, Address());
+            vectorB.assign(dimension, Address());
+            vectorC.assign(dimension, Address());
+            daxpyValue = constructVectors(vectorA, vectorB, vectorC);
+            break;
+        case AlgorithmPolicy::mxm:
+        case AlgorithmPolicy::mxm_block:
+        case AlgorithmPolicy::mxm_sim:
+            // mxm_sim lays its SimArrays out the same way, the tables only serve checkKernel
+            matrixA.assign(dimension, std::vector<Address>(dimension));
+            matrixB.assign(dimension, std::vector<Address>(dimension));
+            matrixC.assign(dimension, std::vector<Address>(dimension));
+            constructMatrix(matrixA, matrixB, matrixC);
+            break;
+    }
+}
+
+void runKernel(){
+    switch (algorithm) {
+        case AlgorithmPolicy::daxpy:
+            vectorWidth > 1 ? emulateDaxpyVector() : emulateDaxpy(); break;
+        case AlgorithmPolicy::mxm:
+            emulateMxm(); break;
+        case AlgorithmPolicy::mxm_block:
+            vectorWidth > 1 ? emulateMxmBlockVector() : emulateMxmBlock(); break;
+        case AlgorithmPolicy::mxm_sim:
+            emulateMxmSimArray(); break;
+    }
+}
+
+void checkKernel(){
+    const char* names[] = {"Daxpy", "Mxm", "Mxm_block", "Mxm_sim"};
+    if(algorithm == AlgorithmPolicy::daxpy){
+        for(int i=0; i<dimension; ++i){
+            assert(ram->getDouble(vectorC[i]) == daxpyD*daxpyValue + 2*daxpyValue);
+        }
+        return;
+    }
+    for(int i=0; i<dimension; ++i){
+        for(int j=0; j<dimension; ++j){
+            assert(ram->getDouble(matrixC[i][j]) == dimension);
+        }
+    }
+    cout << names[(int)algorithm] << " finished. " << endl;
+}
+
+void emulate(){
+    prepareKernel();
+    runKernel();
+    checkKernel();
+}
@@ -0,0 +1,71 @@
+#ifndef PROJECT_DRAFT_EMULATOR_H
+#define PROJECT_DRAFT_EMULATOR_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Address.h"
+#include "Cache.h"
+#include "Ram.h"
+#include "Cpu.h"
+#include "SetSampler.h"
+#include "Tlb.h"
+#include "Dram.h"
+
+enum class AlgorithmPolicy{
+    daxpy,
+    mxm,
+    mxm_block,
+    mxm_sim
+};
+
+const int sz = 8;
+const int addressSize = 32;
+
+// configuration of the next run, set by defaultSettings and the command line
+extern int cacheSize;
+extern int dataBlockSize;
+extern int associativity;
+extern ReplacementPolicy replacement;
+extern IndexFunction indexFunction;
+extern int victimEntries;
+extern int vectorWidth;
+extern bool tlbEnabled;
+extern PageSize pageSize;
+extern std::vector<TlbLevelConfig> tlbLevels;
+extern int pwcEntries;
+extern bool dramEnabled;
+extern DramConfig dramConfig;
+extern AlgorithmPolicy algorithm;
+extern int dimension;
+extern int blockingFactor;
+extern SamplingPolicy sampling;
+extern int samplingRatio;
+extern long warmupReferences;
+extern std::string checkpointSavePath;
+extern std::string checkpointLoadPath;
+// set by initializeEmulator: -cl restores the checkpoint's tags, otherwise they are rebuilt by Checkpoint::rewarm
+extern bool checkpointTagsRestored;
+
+// the emulated machine, rebuilt by initializeEmulator
+extern std::shared_ptr<Ram> ram;
+extern std::shared_ptr<Cache> cache;
+extern std::shared_ptr<Cpu> cpu;
+extern std::shared_ptr<SetSampler> sampler;
+extern std::shared_ptr<Tlb> tlb;
+
+void defaultSettings();
+void resetStatistics();
+// cache for the current configuration, victim buffer included
+std::shared_ptr<Cache> makeCache(const std::shared_ptr<Ram>& backing);
+void initializeEmulator();
+// the configured kernel in three steps: build its address tables and initialize Ram, run the
+// simulated loop, verify the result
+void prepareKernel();
+void runKernel();
+void checkKernel();
+// run the configured kernel, all three steps
+void emulate();
+
+
+#endif //PROJECT_DRAFT_EMULATOR_H
@@ -30,4 +30,4 @@ void Ram::setDouble(const Address& address, const double& value){
 
 double Ram::getDouble(const Address& address){
     return data[address.getRamIndex()]->data[address.getOffset()];
-}
\ No newline at end of file
+}
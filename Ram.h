@@ -9,12 +9,20 @@
 #include <memory>
 #include "Address.h"
 #include "DataBlock.h"
+#include "Dram.h"
 
 class Ram {
 public:
     static int numBlock;
     std::vector<std::shared_ptr<DataBlock>> data;
+    std::shared_ptr<Dram> dram;     // optional timing model
     Ram();
+    // a cache miss served by Ram, only the DRAM model cares about it
+    inline void request(Address address){
+        if(dram){
+            dram->request(address.getRamIndex());
+        }
+    }
     std::shared_ptr<DataBlock> getBlock(Address address);
     void setBlock(Address address, DataBlock& dataBlock);
     void setDouble(const Address& address, const double& value);
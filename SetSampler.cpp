@@ -0,0 +1,89 @@
+#include "SetSampler.h"
+#include "Cache.h"
+#include <cmath>
+
+SetSampler::SetSampler(SamplingPolicy policy, int ratio):
+policy(policy), ratio(ratio), sampledSets(0){
+    sampled.resize(Cache::numSets);
+    readAccess.resize(Cache::numSets);
+    readMiss.resize(Cache::numSets);
+    writeAccess.resize(Cache::numSets);
+    writeMiss.resize(Cache::numSets);
+    for(int i=0; i<Cache::numSets; ++i){
+        switch (policy) {
+            case SamplingPolicy::None:
+                sampled[i] = true; break;
+            case SamplingPolicy::Stride:
+                sampled[i] = i % ratio == 0; break;
+            case SamplingPolicy::Hashed:
+                sampled[i] = hash(i) % ratio == 0; break;
+        }
+        sampledSets += sampled[i];
+    }
+    // a hashed pick may come out empty for tiny caches, keep at least set 0
+    if(sampledSets == 0){
+        sampled[0] = true;
+        sampledSets = 1;
+    }
+}
+
+// murmur3 finalizer, spreads neighbouring set indices over the whole range
+uint32_t SetSampler::hash(uint32_t value){
+    value ^= value >> 16;
+    value *= 0x85ebca6bu;
+    value ^= value >> 13;
+    value *= 0xc2b2ae35u;
+    value ^= value >> 16;
+    return value;
+}
+
+void SetSampler::record(int setIndex, bool isWrite, bool hit){
+    if(isWrite){
+        ++writeAccess[setIndex];
+        writeMiss[setIndex] += !hit;
+    }else{
+        ++readAccess[setIndex];
+        readMiss[setIndex] += !hit;
+    }
+}
+
+// ratio estimator over the sampled sets (cluster sampling without replacement):
+// r = sum(m_i) / sum(a_i), Var(r) ~= (1 - n/N) / (n * mean(a)^2) * sum((m_i - r*a_i)^2) / (n-1)
+SampleEstimate SetSampler::estimate(const std::vector<long>& access, const std::vector<long>& miss) const{
+    double totalAccess = 0, totalMiss = 0;
+    for(int i=0; i<(int)sampled.size(); ++i){
+        if(sampled[i]){
+            totalAccess += (double)access[i];
+            totalMiss += (double)miss[i];
+        }
+    }
+    double scale = (double)sampled.size() / sampledSets;
+    SampleEstimate res{(totalAccess - totalMiss) * scale, totalMiss * scale, 0.0, 0.0};
+    if(totalAccess == 0){
+        return res;
+    }
+    res.missRate = totalMiss / totalAccess;
+    if(sampledSets < 2 || sampledSets == (int)sampled.size()){
+        return res;
+    }
+    double residual = 0;
+    for(int i=0; i<(int)sampled.size(); ++i){
+        if(sampled[i]){
+            double d = (double)miss[i] - res.missRate * (double)access[i];
+            residual += d * d;
+        }
+    }
+    double meanAccess = totalAccess / sampledSets;
+    double fpc = 1.0 - (double)sampledSets / (double)sampled.size();
+    double variance = fpc * residual / (sampledSets - 1) / (sampledSets * meanAccess * meanAccess);
+    res.halfWidth = 1.96 * std::sqrt(variance);
+    return res;
+}
+
+SampleEstimate SetSampler::readEstimate() const{
+    return estimate(readAccess, readMiss);
+}
+
+SampleEstimate SetSampler::writeEstimate() const{
+    return estimate(writeAccess, writeMiss);
+}
@@ -0,0 +1,43 @@
+#ifndef PROJECT_DRAFT_SETSAMPLER_H
+#define PROJECT_DRAFT_SETSAMPLER_H
+
+#include <cstdint>
+#include <vector>
+
+enum class SamplingPolicy {
+    None,
+    Stride,   // every k-th set
+    Hashed    // sets whose hashed index is divisible by k
+};
+
+// scaled-up view of the sampled counters for one access type
+struct SampleEstimate{
+    double hits;
+    double misses;
+    double missRate;      // in [0, 1]
+    double halfWidth;     // 95% confidence half width of missRate
+};
+
+// Only simulates the cache sets picked by the policy. Accesses to the other sets
+// never reach the Cache, their data is served straight from Ram.
+class SetSampler {
+private:
+    std::vector<char> sampled;
+    std::vector<long> readAccess, readMiss, writeAccess, writeMiss;
+    [[nodiscard]] SampleEstimate estimate(const std::vector<long>& access, const std::vector<long>& miss) const;
+public:
+    SamplingPolicy policy;
+    int ratio;
+    int sampledSets;
+    SetSampler(SamplingPolicy policy, int ratio);
+    static uint32_t hash(uint32_t value);
+    [[nodiscard]] inline bool isSampled(int setIndex) const{
+        return sampled[setIndex];
+    }
+    void record(int setIndex, bool isWrite, bool hit);
+    [[nodiscard]] SampleEstimate readEstimate() const;
+    [[nodiscard]] SampleEstimate writeEstimate() const;
+};
+
+
+#endif //PROJECT_DRAFT_SETSAMPLER_H
@@ -0,0 +1,125 @@
+#ifndef PROJECT_DRAFT_SIMARRAY_H
+#define PROJECT_DRAFT_SIMARRAY_H
+
+#include <array>
+#include <cassert>
+#include <stdexcept>
+#include <type_traits>
+#include "Address.h"
+#include "Cpu.h"
+#include "DataBlock.h"
+#include "Ram.h"
+
+enum class Layout {
+    RowMajor,       // last index is contiguous
+    ColumnMajor     // first index is contiguous
+};
+
+// One element of a SimArray. Reading it is a load and assigning to it is a store, both
+// are recorded by the Cpu and replayed through the cache in batches.
+template<class T>
+class SimElement {
+private:
+    Cpu* cpu;
+    Address address;
+public:
+    SimElement(Cpu* cpu, Address address): cpu(cpu), address(address){}
+    operator T() const{
+        return static_cast<T>(cpu->recordLoad(address));
+    }
+    SimElement& operator=(T value){
+        cpu->recordStore(address, static_cast<double>(value));
+        return *this;
+    }
+    SimElement& operator=(const SimElement& other){
+        return *this = static_cast<T>(other);
+    }
+    SimElement& operator+=(T value){ return *this = static_cast<T>(*this) + value; }
+    SimElement& operator-=(T value){ return *this = static_cast<T>(*this) - value; }
+    SimElement& operator*=(T value){ return *this = static_cast<T>(*this) * value; }
+    SimElement& operator/=(T value){ return *this = static_cast<T>(*this) / value; }
+};
+
+
+// Rank-dimensional array living in the emulated Ram, for running plain C++ kernels
+// through the emulator: a[i][k] or a(i, k) give SimElements, a[i] of a rank-2 array is a
+// rank-1 view. Every element takes one 8-byte slot. The kernel must call Cpu::flush()
+// before reading statistics, the last batch is not replayed otherwise.
+template<class T, int Rank = 1>
+class SimArray {
+    static_assert(Rank >= 1, "a SimArray needs at least one dimension");
+    static_assert(std::is_arithmetic_v<T> && sizeof(T) <= sizeof(double), "elements live in 8-byte Ram slots");
+    template<class, int> friend class SimArray;
+private:
+    Cpu* cpu;
+    int base;                           // byte address of element 0
+    std::array<int, Rank> extents;
+    std::array<int, Rank> strides;      // in elements
+    int footprint;                      // bytes, padding included
+    SimArray(Cpu* cpu, int base, const int* extents, const int* strides): cpu(cpu), base(base), footprint(0){
+        for(int d=0; d<Rank; ++d){
+            this->extents[d] = extents[d];
+            this->strides[d] = strides[d];
+        }
+    }
+public:
+    // padding adds unused elements to the contiguous dimension, e.g. to break power-of-two strides
+    SimArray(Cpu& cpu, int baseAddress, const std::array<int, Rank>& extents,
+             Layout layout = Layout::RowMajor, int padding = 0):
+    cpu(&cpu), base(baseAddress), extents(extents), strides(){
+        if(layout == Layout::RowMajor){
+            strides[Rank-1] = 1;
+            for(int d=Rank-2; d>=0; --d){
+                strides[d] = strides[d+1] * (extents[d+1] + (d+1 == Rank-1 ? padding : 0));
+            }
+            footprint = 8 * strides[0] * extents[0];
+        }else{
+            strides[0] = 1;
+            for(int d=1; d<Rank; ++d){
+                strides[d] = strides[d-1] * (extents[d-1] + (d-1 == 0 ? padding : 0));
+            }
+            footprint = 8 * strides[Rank-1] * extents[Rank-1];
+        }
+        if(Rank == 1){
+            footprint = 8 * (extents[0] + padding);
+        }
+        if((long)base + footprint > (long)Ram::numBlock * DataBlock::size * 8){
+            throw std::runtime_error("SimArray does not fit into Ram");
+        }
+    }
+
+    [[nodiscard]] int size(int dimension) const{ return extents[dimension]; }
+    [[nodiscard]] int bytes() const{ return footprint; }
+    // first byte after the array, where the next one can start
+    [[nodiscard]] int end() const{ return base + footprint; }
+
+    // element address without recording a reference, for initialization through Ram
+    template<class... Index>
+    [[nodiscard]] Address address(Index... index) const{
+        static_assert(sizeof...(Index) == Rank, "one index per dimension");
+        const int indices[] = {index...};
+        int offset = 0;
+        for(int d=0; d<Rank; ++d){
+            assert(indices[d] >= 0 && indices[d] < extents[d]);
+            offset += indices[d] * strides[d];
+        }
+        return Address(base + 8 * offset);
+    }
+
+    template<class... Index>
+    SimElement<T> operator()(Index... index) const{
+        return SimElement<T>(cpu, address(index...));
+    }
+
+    auto operator[](int index) const{
+        assert(index >= 0 && index < extents[0]);
+        if constexpr (Rank == 1){
+            return SimElement<T>(cpu, Address(base + 8 * index * strides[0]));
+        }else{
+            return SimArray<T, Rank-1>(cpu, base + 8 * index * strides[0], extents.data() + 1, strides.data() + 1);
+        }
+    }
+};
+
+
+#endif //PROJECT_DRAFT_SIMARRAY_H
@@ -0,0 +1,159 @@
+#include "Tlb.h"
+#include <stdexcept>
+
+TlbLevel::TlbLevel(int entries, int ways): sets(entries / ways), ways(ways), clock(0), hits(0), misses(0){
+    if(ways < 1 || entries < ways || entries % ways != 0){
+        throw std::runtime_error("TLB entries must be a multiple of its associativity");
+    }
+    tags.resize(entries, -1);
+    stamps.resize(entries, 0);
+}
+
+bool TlbLevel::lookup(long page){
+    int base = (int)(page % sets) * ways;
+    ++clock;
+    for(int i=base; i<base+ways; ++i){
+        if(tags[i] == page){
+            stamps[i] = clock;
+            ++hits;
+            return true;
+        }
+    }
+    ++misses;
+    return false;
+}
+
+// replaces the least recently used entry of the set, empty entries have stamp 0
+void TlbLevel::insert(long page){
+    int base = (int)(page % sets) * ways;
+    int victim = base;
+    for(int i=base; i<base+ways; ++i){
+        if(stamps[i] < stamps[victim]){
+            victim = i;
+        }
+    }
+    tags[victim] = page;
+    stamps[victim] = ++clock;
+}
+
+
+int Tlb::pageShiftOf(PageSize pageSize){
+    switch (pageSize) {
+        case PageSize::Page4K: return 12;
+        case PageSize::Page2M: return 21;
+        case PageSize::Page1G: return 30;
+    }
+    return 12;
+}
+
+// 4K pages walk PML4/PDPT/PD/PT, 2M pages stop at the PD and 1G pages at the PDPT
+int Tlb::tableLevelsOf(PageSize pageSize){
+    return (39 - pageShiftOf(pageSize)) / 9 + 1;
+}
+
+long Tlb::pageTableEnd(long dataBytes, PageSize pageSize){
+    const long pageBytes = 4096;
+    long end = (dataBytes + pageBytes - 1) / pageBytes * pageBytes;
+    for(int level=0; level<tableLevelsOf(pageSize); ++level){
+        long entries = ((dataBytes - 1) >> levelShift(level)) + 1;
+        end += (entries * 8 + pageBytes - 1) / pageBytes * pageBytes;
+    }
+    return end;
+}
+
+Tlb::Tlb(PageSize pageSize, const std::vector<TlbLevelConfig>& levelConfigs, int pwcEntries, long dataBytes):
+pageShift(pageShiftOf(pageSize)),
+tableLevels(tableLevelsOf(pageSize)),
+tableBase{},
+pwcEntries(pwcEntries),
+pwcClock(0),
+walks(0), walkReferences(0), walkMisses(0), pwcHits(0){
+    if(levelConfigs.empty()){
+        throw std::runtime_error("the TLB needs at least one level");
+    }
+    for(const auto& config : levelConfigs){
+        levels.emplace_back(config.entries, config.ways);
+    }
+    pwcTags.resize(pwcEntries, -1);
+    pwcStamps.resize(pwcEntries, 0);
+    // same layout as pageTableEnd
+    const long pageBytes = 4096;
+    long base = (dataBytes + pageBytes - 1) / pageBytes * pageBytes;
+    for(int level=0; level<tableLevels; ++level){
+        tableBase[level] = base;
+        long entries = ((dataBytes - 1) >> levelShift(level)) + 1;
+        base += (entries * 8 + pageBytes - 1) / pageBytes * pageBytes;
+    }
+}
+
+// fully-associative LRU over (level, upper address bits) keys
+bool Tlb::pwcLookup(long key){
+    for(int i=0; i<pwcEntries; ++i){
+        if(pwcTags[i] == key){
+            pwcStamps[i] = ++pwcClock;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Tlb::pwcInsert(long key){
+    if(pwcEntries == 0){
+        return;
+    }
+    int victim = 0;
+    for(int i=1; i<pwcEntries; ++i){
+        if(pwcStamps[i] < pwcStamps[victim]){
+            victim = i;
+        }
+    }
+    pwcTags[victim] = key;
+    pwcStamps[victim] = ++pwcClock;
+}
+
+int Tlb::translate(Address address, int* walk){
+    long byte = (long)address.getAll() << 3;
+    long page = byte >> pageShift;
+    int level = 0;
+    for(; level<(int)levels.size(); ++level){
+        if(levels[level].lookup(page)){
+            break;
+        }
+    }
+    // refill the levels that missed, from the one that hit (or the walk) upwards
+    for(int i=0; i<level; ++i){
+        levels[i].insert(page);
+    }
+    if(level < (int)levels.size()){
+        return 0;
+    }
+
+    ++walks;
+    // the deepest non-leaf entry held by the page-walk cache decides where the walk starts,
+    // the non-leaf entries read after it are added to the page-walk cache
+    int start = 0;
+    for(int table=tableLevels-2; table>=0; --table){
+        long key = ((long)table << 48) | (byte >> levelShift(table));
+        if(pwcLookup(key)){
+            ++pwcHits;
+            start = table + 1;
+            break;
+        }
+    }
+    for(int table=start; table<tableLevels-1; ++table){
+        pwcInsert(((long)table << 48) | (byte >> levelShift(table)));
+    }
+    int count = 0;
+    for(int table=start; table<tableLevels; ++table){
+        walk[count++] = (int)(tableBase[table] + (byte >> levelShift(table)) * 8);
+    }
+    walkReferences += count;
+    return count;
+}
+
+void Tlb::resetStatistics(){
+    for(auto& level : levels){
+        level.hits = level.misses = 0;
+    }
+    walks = walkReferences = walkMisses = pwcHits = 0;
+}
@@ -0,0 +1,70 @@
+#ifndef PROJECT_DRAFT_TLB_H
+#define PROJECT_DRAFT_TLB_H
+
+#include <vector>
+#include "Address.h"
+
+enum class PageSize {
+    Page4K,
+    Page2M,
+    Page1G
+};
+
+struct TlbLevelConfig{
+    int entries;
+    int ways;
+};
+
+// one set-associative LRU translation buffer, keyed by virtual page number
+class TlbLevel {
+private:
+    int sets;
+    int ways;
+    std::vector<long> tags;     // sets*ways, -1 when empty
+    std::vector<long> stamps;
+    long clock;
+public:
+    long hits;
+    long misses;
+    TlbLevel(int entries, int ways);
+    bool lookup(long page);
+    void insert(long page);
+};
+
+// Multi-level TLB with an x86-64 style radix page table behind it. The emulator has no
+// separate physical space: data is identity mapped, and the page table itself lives in Ram
+// right after the data, one contiguous array per level. A miss in every level walks the
+// table; the page-walk cache holds upper-level entries so the walk can start lower down.
+// translate() only names the table entries to read, the Cpu sends them through the cache.
+class Tlb {
+private:
+    static const int maxLevels = 4;
+    int pageShift;
+    int tableLevels;
+    long tableBase[maxLevels];
+    std::vector<TlbLevel> levels;
+    int pwcEntries;
+    std::vector<long> pwcTags;
+    std::vector<long> pwcStamps;
+    long pwcClock;
+    [[nodiscard]] static int levelShift(int level){ return 39 - 9*level; }
+    bool pwcLookup(long key);
+    void pwcInsert(long key);
+public:
+    long walks;
+    long walkReferences;
+    long walkMisses;    // walk references that missed the data cache
+    long pwcHits;
+    static int pageShiftOf(PageSize pageSize);
+    static int tableLevelsOf(PageSize pageSize);
+    // first byte after the page table that maps [0, dataBytes)
+    static long pageTableEnd(long dataBytes, PageSize pageSize);
+    Tlb(PageSize pageSize, const std::vector<TlbLevelConfig>& levelConfigs, int pwcEntries, long dataBytes);
+    // returns how many page table entries have to be read, their byte addresses go to walk
+    int translate(Address address, int* walk);
+    [[nodiscard]] const std::vector<TlbLevel>& getLevels() const{ return levels; }
+    void resetStatistics();
+};
+
+
+#endif //PROJECT_DRAFT_TLB_H
@@ -0,0 +1,79 @@
+#include "VictimCache.h"
+#include <stdexcept>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+VictimCache::VictimCache(int capacity): next(0), capacity(capacity){
+    if(capacity < 1 || capacity > maxEntries){
+        throw std::runtime_error("victim cache size must be between 1 and 64 entries");
+    }
+    for(int i=0; i<maxEntries; ++i){
+        blocks[i] = i < capacity ? emptySlot : paddingSlot;
+    }
+}
+
+// index of the first slot holding block, or -1
+int VictimCache::find(int block) const{
+#if defined(__AVX2__)
+    __m256i key = _mm256_set1_epi32(block);
+    for(int i=0; i<capacity; i+=8){
+        __m256i lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(blocks + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(lanes, key)));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return -1;
+#elif defined(__SSE2__)
+    __m128i key = _mm_set1_epi32(block);
+    for(int i=0; i<capacity; i+=4){
+        __m128i lanes = _mm_load_si128(reinterpret_cast<const __m128i*>(blocks + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lanes, key)));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return -1;
+#else
+    for(int i=0; i<capacity; ++i){
+        if(blocks[i] == block){
+            return i;
+        }
+    }
+    return -1;
+#endif
+}
+
+bool VictimCache::probe(int block){
+    int slot = find(block);
+    if(slot < 0){
+        return false;
+    }
+    blocks[slot] = emptySlot;
+    return true;
+}
+
+// fills the first empty slot, otherwise replaces round robin
+void VictimCache::insert(int block){
+    int slot = find(emptySlot);
+    if(slot < 0){
+        slot = next;
+        next = (next + 1) % capacity;
+    }
+    blocks[slot] = block;
+}
+
+void VictimCache::save(CheckpointWriter& writer) const{
+    writer.put<int>(capacity);
+    writer.put<int>(next);
+    writer.putBytes(blocks, sizeof(int) * capacity);
+}
+
+void VictimCache::restore(CheckpointReader& reader){
+    if(reader.get<int>() != capacity){
+        throw std::runtime_error("checkpoint holds a victim cache of another size");
+    }
+    next = reader.get<int>();
+    std::memcpy(blocks, reader.getBytes(sizeof(int) * capacity), sizeof(int) * capacity);
+}
@@ -0,0 +1,30 @@
+#ifndef PROJECT_DRAFT_VICTIMCACHE_H
+#define PROJECT_DRAFT_VICTIMCACHE_H
+
+#include "Checkpoint.h"
+
+// Small fully-associative buffer behind the cache. It holds the block numbers of recently
+// evicted lines in one fixed array that is searched with SIMD compares, there is no per-entry object.
+// On a cache miss the buffer is probed before Ram; a hit removes the line from here and the
+// line the cache evicts for it takes its place (swap).
+class VictimCache {
+public:
+    static const int maxEntries = 64;
+private:
+    static const int emptySlot = -1;
+    static const int paddingSlot = -2;   // lanes past capacity, never match a block or an empty slot
+    alignas(32) int blocks[maxEntries];
+    int next;
+    [[nodiscard]] int find(int block) const;
+public:
+    int capacity;
+    explicit VictimCache(int capacity);
+    // removes block and returns true when it is buffered
+    bool probe(int block);
+    void insert(int block);
+    void save(CheckpointWriter& writer) const;
+    void restore(CheckpointReader& reader);
+};
+
+
+#endif //PROJECT_DRAFT_VICTIMCACHE_H
@@ -0,0 +1,396 @@
+// Throughput benchmark of the emulator itself: every replacement policy across
+// associativities, block sizes, the built-in kernels and two synthetic traces.
+// Each configuration runs in a forked child so peak RSS is per run.
+//
+//   Project_Draft_Bench [-reps n] [-only text] [-save file] [-baseline file] [-tol fraction]
+//
+// With -baseline the exit code is 1 when any configuration is slower, allocates more
+// or uses more memory than the baseline by more than the tolerance (default 0.10).
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "Emulator.h"
+
+using namespace std;
+
+// every heap allocation of the process goes through here
+static std::atomic<long> allocations{0};
+static std::atomic<long> allocatedBytes{0};
+
+void* operator new(std::size_t size){
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add((long)size, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1)){
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size){
+    return operator new(size);
+}
+void operator delete(void* p) noexcept{
+    std::free(p);
+}
+void operator delete[](void* p) noexcept{
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept{
+    std::free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept{
+    std::free(p);
+}
+
+enum class Workload{
+    daxpy,
+    mxm,
+    mxm_block,
+    randomTrace,    // uniform over the footprint, one in four references a store
+    streamTrace     // sequential doubles over the footprint, one in four references a store
+};
+
+const char* workloadName(Workload workload){
+    switch (workload) {
+        case Workload::daxpy: return "daxpy";
+        case Workload::mxm: return "mxm";
+        case Workload::mxm_block: return "mxm_block";
+        case Workload::randomTrace: return "random";
+        case Workload::streamTrace: return "stream";
+    }
+    return "";
+}
+
+const char* policyName(ReplacementPolicy policy){
+    switch (policy) {
+        case ReplacementPolicy::Random: return "random";
+        case ReplacementPolicy::FIFO: return "FIFO";
+        case ReplacementPolicy::LRU: return "LRU";
+    }
+    return "";
+}
+
+struct BenchCase{
+    ReplacementPolicy policy;
+    int associativity;
+    int blockSize;
+    Workload workload;
+    [[nodiscard]] std::string name() const{
+        std::ostringstream res;
+        res << policyName(policy) << "/" << associativity << "way/" << blockSize << "B/" << workloadName(workload);
+        return res.str();
+    }
+};
+
+// what a child sends back through the pipe
+struct BenchResult{
+    long references;
+    double seconds;         // best of the repetitions
+    long allocations;       // heap allocations during one timed run
+    long allocatedBytes;
+    long misses;
+    long peakRssKB;         // filled in by the parent
+};
+
+struct Measurement{
+    double refsPerSecond;
+    long allocations;
+    long peakRssKB;
+};
+
+// sizes kept small so the whole matrix runs in seconds; the cache is L1-sized so
+// every kernel misses
+const int benchCacheSize = 32768;
+const int daxpyDimension = 500000;
+const int mxmDimension = 96;
+const int traceReferences = 1 << 20;
+const int traceFootprint = 4 << 20;     // bytes
+
+void configure(const BenchCase& bench){
+    defaultSettings();
+    cacheSize = benchCacheSize;
+    dataBlockSize = bench.blockSize;
+    associativity = bench.associativity;
+    replacement = bench.policy;
+    blockingFactor = 32;
+    switch (bench.workload) {
+        case Workload::daxpy:
+            algorithm = AlgorithmPolicy::daxpy;
+            dimension = daxpyDimension; break;
+        case Workload::mxm:
+            algorithm = AlgorithmPolicy::mxm;
+            dimension = mxmDimension; break;
+        case Workload::mxm_block:
+            algorithm = AlgorithmPolicy::mxm_block;
+            dimension = mxmDimension; break;
+        case Workload::randomTrace:
+        case Workload::streamTrace:
+            // daxpy sizes Ram to 3 * dimension doubles
+            algorithm = AlgorithmPolicy::daxpy;
+            dimension = (traceFootprint + 3*sz - 1) / (3*sz); break;
+    }
+}
+
+// addresses are generated before timing so only the simulator is measured
+std::vector<MemoryReference> makeTrace(Workload workload){
+    std::vector<MemoryReference> trace(traceReferences);
+    const int doubles = traceFootprint / sz;
+    std::mt19937 rng(12345);
+    for(int i=0; i<traceReferences; ++i){
+        int slot = workload == Workload::randomTrace ? (int)(rng() % doubles) : i % doubles;
+        trace[i] = {Address(slot * sz), i % 4 == 3};
+    }
+    return trace;
+}
+
+void replay(const std::vector<MemoryReference>& trace){
+    double value = 0;
+    for(const MemoryReference& reference : trace){
+        if(reference.isWrite){
+            cpu->storeDouble(reference.address, value);
+        }else{
+            value += cpu->loadDouble(reference.address);
+        }
+    }
+}
+
+BenchResult runCase(const BenchCase& bench, int repetitions){
+    BenchResult res{0, 1e300, 0, 0, 0, 0};
+    configure(bench);
+    std::vector<MemoryReference> trace;
+    bool synthetic = bench.workload == Workload::randomTrace || bench.workload == Workload::streamTrace;
+    if(synthetic){
+        trace = makeTrace(bench.workload);
+    }
+    for(int r=0; r<repetitions; ++r){
+        // free the previous machine first, or peak RSS counts two of them
+        cpu = nullptr;
+        cache = nullptr;
+        ram = nullptr;
+        initializeEmulator();
+        // only the simulated loop is timed: address tables, Ram values and the check stay outside
+        if(!synthetic){
+            prepareKernel();
+        }
+        long allocationsBefore = allocations.load(), bytesBefore = allocatedBytes.load();
+        auto start = std::chrono::steady_clock::now();
+        if(synthetic){
+            replay(trace);
+        }else{
+            runKernel();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        res.seconds = std::min(res.seconds, seconds);
+        res.allocations = allocations.load() - allocationsBefore;
+        res.allocatedBytes = allocatedBytes.load() - bytesBefore;
+        if(!synthetic){
+            checkKernel();
+        }
+        // no sampling or TLB here, so every reference is one cache access
+        res.references = (long)Cache::readHit + Cache::readMiss + Cache::writeHit + Cache::writeMiss;
+        res.misses = (long)Cache::readMiss + Cache::writeMiss;
+    }
+    return res;
+}
+
+// run one configuration in a child process, throws if the child fails
+BenchResult forkCase(const BenchCase& bench, int repetitions){
+    int fds[2];
+    if(pipe(fds) != 0){
+        throw std::runtime_error("cannot create pipe");
+    }
+    std::cout.flush();
+    pid_t pid = fork();
+    if(pid < 0){
+        throw std::runtime_error("cannot fork");
+    }
+    if(pid == 0){
+        close(fds[0]);
+        std::cout.rdbuf(nullptr);   // the kernels report progress on cout
+        int status = 0;
+        try{
+            BenchResult res = runCase(bench, repetitions);
+            if(write(fds[1], &res, sizeof(res)) != (ssize_t)sizeof(res)){
+                status = 1;
+            }
+        }catch(const std::exception& e){
+            std::cerr << "Error: " << e.what() << std::endl;
+            status = 1;
+        }
+        _exit(status);
+    }
+    close(fds[1]);
+    BenchResult res{};
+    ssize_t received = read(fds[0], &res, sizeof(res));
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage{};
+    wait4(pid, &status, 0, &usage);
+    if(received != (ssize_t)sizeof(res) || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+        throw std::runtime_error("benchmark " + bench.name() + " failed");
+    }
+    res.peakRssKB = usage.ru_maxrss;
+    return res;
+}
+
+// one line per configuration: name refs/sec allocations peak RSS in KB
+std::map<std::string, Measurement> loadBaseline(const std::string& path){
+    std::ifstream in(path);
+    if(!in){
+        throw std::runtime_error("cannot open baseline " + path);
+    }
+    std::map<std::string, Measurement> res;
+    std::string line;
+    while(std::getline(in, line)){
+        if(line.empty() || line[0] == '#'){
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string name;
+        Measurement m{};
+        if(fields >> name >> m.refsPerSecond >> m.allocations >> m.peakRssKB){
+            res[name] = m;
+        }
+    }
+    return res;
+}
+
+void saveBaseline(const std::string& path, const std::vector<std::pair<std::string, Measurement>>& results){
+    std::ofstream out(path);
+    if(!out){
+        throw std::runtime_error("cannot write baseline " + path);
+    }
+    out << "# name refs/sec allocations peakRssKB" << std::endl;
+    for(const auto& [name, m] : results){
+        out << name << " " << std::fixed << std::setprecision(0) << m.refsPerSecond << " "
+            << m.allocations << " " << m.peakRssKB << std::endl;
+    }
+}
+
+// empty when the measurement is within tolerance of the baseline
+std::string compare(const Measurement& now, const Measurement& base, double tolerance){
+    std::ostringstream res;
+    if(now.refsPerSecond < base.refsPerSecond * (1.0 - tolerance)){
+        res << "slower by " << std::fixed << std::setprecision(1)
+            << 100.0 * (1.0 - now.refsPerSecond / base.refsPerSecond) << "% ";
+    }
+    if(now.allocations > base.allocations * (1.0 + tolerance)){
+        res << "allocations " << base.allocations << "->" << now.allocations << " ";
+    }
+    if(now.peakRssKB > base.peakRssKB * (1.0 + tolerance)){
+        res << "peak RSS " << base.peakRssKB << "->" << now.peakRssKB << "KB ";
+    }
+    return res.str();
+}
+
+int main(int argc, char** argv){
+    int repetitions = 3;
+    double tolerance = 0.10;
+    std::string only, savePath, baselinePath;
+    for(int i=1; i<argc; ++i){
+        std::string arg = argv[i];
+        if(arg == "-reps" && i+1<argc){
+            repetitions = std::max(1, std::stoi(argv[++i]));
+        }else if(arg == "-only" && i+1<argc){
+            only = argv[++i];
+        }else if(arg == "-save" && i+1<argc){
+            savePath = argv[++i];
+        }else if(arg == "-baseline" && i+1<argc){
+            baselinePath = argv[++i];
+        }else if(arg == "-tol" && i+1<argc){
+            tolerance = std::stod(argv[++i]);
+        }
+    }
+
+    std::vector<BenchCase> cases;
+    for(ReplacementPolicy policy : {ReplacementPolicy::Random, ReplacementPolicy::FIFO, ReplacementPolicy::LRU}){
+        for(int ways : {1, 2, 8}){
+            for(int block : {32, 64, 128}){
+                for(Workload workload : {Workload::daxpy, Workload::mxm, Workload::mxm_block,
+                                         Workload::randomTrace, Workload::streamTrace}){
+                    BenchCase bench{policy, ways, block, workload};
+                    if(only.empty() || bench.name().find(only) != std::string::npos){
+                        cases.push_back(bench);
+                    }
+                }
+            }
+        }
+    }
+
+    std::map<std::string, Measurement> baseline;
+    try{
+        if(!baselinePath.empty()){
+            baseline = loadBaseline(baselinePath);
+        }
+
+        std::cout << "SIMULATOR THROUGHPUT=======================" << std::endl;
+        std::cout << "Cache Size =                 " << benchCacheSize << " bytes" << std::endl;
+        std::cout << "Repetitions =                " << repetitions << " (best time kept)" << std::endl;
+        if(!baselinePath.empty()){
+            std::cout << "Baseline =                   " << baselinePath << " (tolerance "
+                      << 100.0 * tolerance << "%)" << std::endl;
+        }
+        std::cout << std::left << std::setw(28) << "configuration" << std::setw(11) << "refs"
+                  << std::setw(12) << "Mrefs/s" << std::setw(10) << "ns/ref" << std::setw(10) << "miss%"
+                  << std::setw(8) << "allocs" << std::setw(12) << "peak RSS" << "vs baseline" << std::endl;
+
+        std::vector<std::pair<std::string, Measurement>> results;
+        int regressions = 0;
+        for(const BenchCase& bench : cases){
+            BenchResult r = forkCase(bench, repetitions);
+            Measurement m{(double)r.references / std::max(r.seconds, 1e-9), r.allocations, r.peakRssKB};
+            results.emplace_back(bench.name(), m);
+
+            std::string verdict = "-";
+            auto found = baseline.find(bench.name());
+            if(found != baseline.end()){
+                std::string regression = compare(m, found->second, tolerance);
+                std::ostringstream delta;
+                delta << std::showpos << std::fixed << std::setprecision(1)
+                      << 100.0 * (m.refsPerSecond / found->second.refsPerSecond - 1.0) << "%";
+                verdict = regression.empty() ? delta.str() : "REGRESSION " + regression;
+                regressions += !regression.empty();
+            }else if(!baselinePath.empty()){
+                verdict = "new";
+            }
+            std::ostringstream rss;
+            rss << r.peakRssKB / 1024 << "MB";
+            std::cout << std::left << std::fixed << std::setprecision(2) << std::setw(28) << bench.name()
+                      << std::setw(11) << r.references << std::setw(12) << m.refsPerSecond / 1e6
+                      << std::setw(10) << 1e9 * r.seconds / std::max(1L, r.references)
+                      << std::setw(10) << 100.0 * r.misses / std::max(1L, r.references)
+                      << std::setw(8) << r.allocations << std::setw(12) << rss.str() << verdict << std::endl;
+        }
+        std::cout << std::right;
+
+        if(!savePath.empty()){
+            saveBaseline(savePath, results);
+            std::cout << "Baseline saved to " << savePath << std::endl;
+        }
+        if(!baselinePath.empty()){
+            std::cout << regressions << " of " << results.size() << " configurations regressed" << std::endl;
+            if(regressions > 0){
+                return 1;
+            }
+        }
+    }catch(const std::exception& e){
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -5,55 +5,36 @@
 #include <string>
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <cstdint>
+#include <climits>
+#include <atomic>
+#include <thread>
 
-#include "Address.h"
-#include "DataBlock.h"
-#include "Cache.h"
-#include "Ram.h"
-#include "Cpu.h"
+#include "Emulator.h"
 
 using namespace std;
 
-enum class ReplacementPolicy {
-    Random,
-    FIFO,
-    LRU
-};
-
-enum class AlgorithmPolicy{
-    daxpy,
-    mxm,
-    mxm_block
-};
-
-const int sz = 8;
-const int addressSize = 32;
-
-int cacheSize;
-int dataBlockSize;
-int associativity;
-ReplacementPolicy replacement;
-AlgorithmPolicy algorithm;
-int dimension;
+bool indexComparison;
+bool tlbComparison;
+bool tuning;
+std::vector<int> tileSizes;
+int tuningThreads;
 bool printEnabled;
-int blockingFactor;
-
-shared_ptr<Ram> ram;
-shared_ptr<Cache> cache;
-shared_ptr<Cpu> cpu;
+bool samplingValidation;
 
 void parseInput(int argc, char** argv){
 
-
-    // default settings
-    cacheSize = 524288;
-    dataBlockSize = 64;   // first /8 then*8? keep it as a multiple of 8
-    associativity = 2;
-    replacement = ReplacementPolicy::LRU;
-    algorithm = AlgorithmPolicy::mxm_block;  // [TODO] change back to mxm_block back !
+    defaultSettings();
+    indexComparison = false;
+    tlbComparison = false;
+    tuning = false;
+    tileSizes = {8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384};
+    tuningThreads = (int)std::max(1u, std::thread::hardware_concurrency());
     printEnabled = true;
-    dimension = 480;
-    blockingFactor = 32;
+    samplingValidation = false;
 
     // read in input arguments
     for(int i=1; i<argc; ++i){
@@ -71,6 +52,80 @@ void parseInput(int argc, char** argv){
             }else if(r=="random"){
                 replacement = ReplacementPolicy::Random;
             }
+        }else if(arg == "-i" && i+1<argc){
+            std::string f = argv[++i];
+            if(f=="xor"){
+                indexFunction = IndexFunction::XorFold;
+            }else if(f=="prime"){
+                indexFunction = IndexFunction::PrimeModulo;
+            }else if(f=="skew"){
+                indexFunction = IndexFunction::Skewed;
+            }else if(f=="mod"){
+                indexFunction = IndexFunction::Modulo;
+            }
+        }else if(arg == "-v" && i+1<argc){
+            victimEntries = std::stoi(argv[++i]);
+        }else if(arg == "-vw" && i+1<argc){
+            vectorWidth = std::stoi(argv[++i]);
+        }else if(arg == "-tlb" && i+1<argc){
+            tlbEnabled = true;
+            std::string t = argv[++i];
+            if(t=="2M"){
+                pageSize = PageSize::Page2M;
+            }else if(t=="1G"){
+                pageSize = PageSize::Page1G;
+            }else{
+                pageSize = PageSize::Page4K;
+            }
+        }else if(arg == "-tlbl" && i+1<argc){
+            // entries:ways per level, comma separated, e.g. 64:4,1536:12
+            tlbLevels.clear();
+            std::stringstream spec(argv[++i]);
+            std::string level;
+            while(std::getline(spec, level, ',')){
+                size_t colon = level.find(':');
+                int entries = std::stoi(level.substr(0, colon));
+                int ways = colon == std::string::npos ? entries : std::stoi(level.substr(colon + 1));
+                tlbLevels.push_back({entries, ways});
+            }
+        }else if(arg == "-pwc" && i+1<argc){
+            pwcEntries = std::stoi(argv[++i]);
+        }else if(arg == "-dram"){
+            dramEnabled = true;
+        }else if(arg == "-dramc" && i+1<argc){
+            // channels:ranks:banks
+            dramEnabled = true;
+            std::string geometry = argv[++i];
+            size_t first = geometry.find(':'), second = geometry.find(':', first + 1);
+            dramConfig.channels = std::stoi(geometry.substr(0, first));
+            dramConfig.ranks = std::stoi(geometry.substr(first + 1, second - first - 1));
+            dramConfig.banks = std::stoi(geometry.substr(second + 1));
+        }else if(arg == "-dramp" && i+1<argc){
+            dramEnabled = true;
+            std::string policy = argv[++i];
+            dramConfig.policy = policy == "closed" ? RowPolicy::Closed : RowPolicy::Open;
+        }else if(arg == "-dramm" && i+1<argc){
+            dramEnabled = true;
+            dramConfig.mapping = argv[++i];
+        }else if(arg == "-dramq" && i+1<argc){
+            dramEnabled = true;
+            dramConfig.queueDepth = std::stoi(argv[++i]);
+        }else if(arg == "-tune"){
+            tuning = true;
+        }else if(arg == "-ts" && i+1<argc){
+            // candidate tile edges, comma separated
+            tileSizes.clear();
+            std::stringstream spec(argv[++i]);
+            std::string size;
+            while(std::getline(spec, size, ',')){
+                tileSizes.push_back(std::stoi(size));
+            }
+        }else if(arg == "-tj" && i+1<argc){
+            tuningThreads = std::max(1, std::stoi(argv[++i]));
+        }else if(arg == "-ct"){
+            tlbComparison = true;
+        }else if(arg == "-ci"){
+            indexComparison = true;
         }else if(arg == "-d" && i+1<argc){
             dimension = std::stoi(argv[++i]);
         }else if(arg == "-a" && i+1<argc){
@@ -79,56 +134,35 @@ void parseInput(int argc, char** argv){
                 algorithm = AlgorithmPolicy::daxpy;
             }else if(a=="mxm"){
                 algorithm = AlgorithmPolicy::mxm;
+            }else if(a=="mxm_sim"){
+                algorithm = AlgorithmPolicy::mxm_sim;
             }
         }else if(arg == "-p"){
             printEnabled = true;
         }else if(arg == "-f" && i+1<argc){
             blockingFactor = std::stoi(argv[++i]);
+        }else if(arg == "-s" && i+1<argc){
+            sampling = SamplingPolicy::Stride;
+            samplingRatio = std::stoi(argv[++i]);
+        }else if(arg == "-sh" && i+1<argc){
+            sampling = SamplingPolicy::Hashed;
+            samplingRatio = std::stoi(argv[++i]);
+        }else if(arg == "-vs"){
+            samplingValidation = true;
+        }else if(arg == "-w" && i+1<argc){
+            warmupReferences = std::stol(argv[++i]);
+        }else if(arg == "-cs" && i+1<argc){
+            // cache tags and block recency after the -w warm-up, Ram contents are not stored
+            checkpointSavePath = argv[++i];
+        }else if(arg == "-cl" && i+1<argc){
+            // replays the checkpoint's prefix on Ram only, then restores the tags when the cache
+            // configuration matches or rebuilds them from the recorded block recency when it does not
+            checkpointLoadPath = argv[++i];
         }
     }
 
 }
 
-
-void initializeEmulator(){
-
-    // initialize Data Block
-    DataBlock::size = dataBlockSize / sz;   // suppose divisible!
-
-    // initialize Cache
-    Cache::numBlocks = cacheSize / dataBlockSize;  // suppose divisible!
-    Cache::numSets = Cache::numBlocks / associativity;  // suppose divisible!
-
-    // initialize Address
-    Address::indexSize = std::ceil(std::log(Cache::numSets) / std::log(2));
-    Address::offsetSize = std::ceil(std::log(DataBlock::size) / std::log(2));
-    Address::tagSize = addressSize - Address::indexSize - Address::offsetSize;
-
-
-
-    // initialize Ram
-    if(algorithm==AlgorithmPolicy::daxpy){
-        Ram::numBlock = ceil(3.0 * dimension / DataBlock::size);
-    }else{
-        Ram::numBlock = ceil(3.0 * dimension * dimension / DataBlock::size);
-    }
-
-    ram = make_shared<Ram>();
-
-
-    switch (replacement) {
-        case ReplacementPolicy::Random:
-            cache = make_shared<RandomCache>(ram); break;
-        case ReplacementPolicy::LRU:
-            cache = make_shared<LRUCache>(ram); break;
-        case ReplacementPolicy::FIFO:
-            cache = make_shared<FIFOCache>(ram); break;
-    }
-
-    cpu = make_shared<Cpu>(cache);
-
-}
-
 void printInput(){
     std::cout << "INPUTS====================================" << std::endl;
     std::cout << "Ram Size =                   " << Ram::numBlock * DataBlock::size * sz << " bytes" << std::endl;
@@ -145,6 +179,31 @@ void printInput(){
         case ReplacementPolicy::FIFO:
             std::cout << "Replacement Policy =         FIFO" << std::endl; break;
     }
+    switch (indexFunction) {
+        case IndexFunction::Modulo:
+            std::cout << "Index Function =             modulo" << std::endl; break;
+        case IndexFunction::XorFold:
+            std::cout << "Index Function =             xor-fold" << std::endl; break;
+        case IndexFunction::PrimeModulo:
+            std::cout << "Index Function =             prime modulo" << std::endl; break;
+        case IndexFunction::Skewed:
+            std::cout << "Index Function =             skewed" << std::endl; break;
+    }
+    if(victimEntries > 0)
+        std::cout << "Victim Cache =               " << victimEntries << " entries" << std::endl;
+    if(ram->dram){
+        std::cout << "DRAM =                       " << dramConfig.channels << " channels, " << dramConfig.ranks << " ranks, "
+                  << dramConfig.banks << " banks, " << (dramConfig.policy == RowPolicy::Open ? "open" : "closed")
+                  << " rows, " << dramConfig.mapping << ", queue " << dramConfig.queueDepth << std::endl;
+    }
+    if(tlb){
+        std::cout << "TLB =                        " << (pageSize == PageSize::Page4K ? "4K" : pageSize == PageSize::Page2M ? "2M" : "1G")
+                  << " pages,";
+        for(const auto& level : tlbLevels){
+            std::cout << " " << level.entries << "x" << level.ways << "-way";
+        }
+        std::cout << ", page-walk cache " << pwcEntries << " entries" << std::endl;
+    }
     switch (algorithm) {
         case AlgorithmPolicy::daxpy:
             std::cout << "Algorithm =                  daxpy" << std::endl; break;
@@ -152,16 +211,32 @@ void printInput(){
             std::cout << "Algorithm =                  mxm" << std::endl; break;
         case AlgorithmPolicy::mxm_block:
             std::cout << "Algorithm =                  mxm_block" << std::endl; break;
+        case AlgorithmPolicy::mxm_sim:
+            std::cout << "Algorithm =                  mxm_sim (SimArray)" << std::endl; break;
     }
     if(algorithm==AlgorithmPolicy::mxm_block)
         std::cout << "MXM Blocking Factor =        " << blockingFactor << std::endl;
     std::cout << "Matrix or Vector dimension = " << dimension << std::endl;
+    if(vectorWidth > 1 && algorithm != AlgorithmPolicy::mxm)
+        std::cout << "Vector Width =               " << vectorWidth << " doubles" << std::endl;
+    if(sampler){
+        std::cout << "Set Sampling =               " << (sampling == SamplingPolicy::Stride ? "every " : "hashed 1 in ")
+                  << samplingRatio << " (" << sampler->sampledSets << " sets)" << std::endl;
+    }
+    if(Cpu::fastForward > 0){
+        std::cout << "Fast-forward =               " << Cpu::fastForward << " references "
+                  << (checkpointLoadPath.empty() ? "(warm)" : "(from " + checkpointLoadPath
+                      + (checkpointTagsRestored ? ", tags restored)" : ", tags rebuilt from block recency)"))
+                  << std::endl;
+    }
 }
 
 void printResult(){
     cout << "RESULTS====================================" << endl;
     cout << "Address: index/tag/offset: " << Address::indexSize << "/" << Address::tagSize << "/" << Address::offsetSize << endl;
     cout << "Instruction count: " << Cpu::instructionCount << endl;
+    if(vectorWidth > 1)
+        cout << "Cross-line vector accesses: " << Cpu::crossLineAccesses << endl;
     cout << "Read hits:         " << Cache::readHit << endl;
     cout << "Read misses:       " << Cache::readMiss << endl;
     cout << "Read miss rate:    " << std::fixed << std::setprecision(2)
@@ -170,165 +245,296 @@ void printResult(){
     cout << "Write misses:      " << Cache::writeMiss << endl;
     cout << "Write miss rate:   " << std::fixed << std::setprecision(2)
          << 100.0*Cache::writeMiss / (Cache::writeHit + Cache::writeMiss) << "%" << endl;
-}
-
-
-void emulateDaxpy(){
-    // emulate c = a*D + b
-    // construct array of address
-    std::vector<Address> a(dimension), b(dimension), c(dimension);
-    int address = 0;
-    for(int i=0; i<dimension; ++i){
-        a[i] = Address(address);
-        b[i] = Address(sz*dimension+address);
-        c[i] = Address(2*sz*dimension+address);
-        address += sz;
+    if(cache->victim){
+        // victim hits are a subset of the misses above, the rest went to Ram
+        cout << "Victim hits:       " << Cache::victimHit << endl;
+        cout << "Victim hit rate:   " << std::fixed << std::setprecision(2)
+             << 100.0*Cache::victimHit / std::max(1, Cache::readMiss + Cache::writeMiss) << "% of misses" << endl;
+        cout << "Misses to Ram:     " << Cache::readMiss + Cache::writeMiss - Cache::victimHit << endl;
     }
-
-    // insert some value in ram
-    int value = 1;
-    for(int i=0; i<dimension; ++i){
-        ram->setDouble(a[i], value);
-        ram->setDouble(b[i], 2*value);
-        ram->setDouble(c[i], 0);
+    if(tlb){
+        cout << "TLB=======================================" << endl;
+        for(int l=0; l<(int)tlb->getLevels().size(); ++l){
+            const TlbLevel& level = tlb->getLevels()[l];
+            cout << "L" << l+1 << " TLB hits/misses: " << level.hits << "/" << level.misses << " ("
+                 << std::setprecision(2) << 100.0*level.hits / std::max(1L, level.hits + level.misses) << "% hits)" << endl;
+        }
+        cout << "Page walks:        " << tlb->walks << endl;
+        cout << "Walk references:   " << tlb->walkReferences << " (" << tlb->walkMisses << " cache misses)" << endl;
+        cout << "Page-walk cache hits: " << tlb->pwcHits << endl;
     }
-    cout << "Value initialized. " << endl;
-
-    // put a random D value in register
-    double register0 = 3, register1, register2, register3, register4;
-
-    // Run the daxpy
-    for(int i=0; i<dimension; ++i){
-        register1 = cpu->loadDouble(Address(a[i]));
-        register2 = cpu->Cpu::multDouble(register0, register1);
-        register3 = cpu->loadDouble(Address(b[i]));
-        register4 = cpu->Cpu::addDouble(register2, register3);
-        cpu ->storeDouble(Address(c[i]), register4);
+    if(ram->dram){
+        Dram& dram = *ram->dram;
+        dram.drain();
+        cout << "DRAM======================================" << endl;
+        cout << "DRAM requests:     " << dram.requests << endl;
+        cout << "Row hit rate:      " << std::setprecision(2) << 100.0*dram.rowHitRate() << "%" << endl;
+        cout << "Row misses:        " << dram.rowMisses << endl;
+        cout << "Bank conflicts:    " << dram.bankConflicts << endl;
+        cout << "Avg latency:       " << dram.averageLatency() << " cycles" << endl;
+        cout << "Queue full stalls: " << dram.queueFullStalls << " (" << dram.stallCycles << " cycles)" << endl;
+        cout << "Bandwidth:         " << dram.bandwidthGBs(dataBlockSize) << " GB/s" << endl;
     }
-
-    // verify result:
-    for(int i=0; i<dimension; ++i){
-        assert(ram->getDouble(c[i]) == register0*value + 2*value);
+    if(sampler){
+        // the counters above only cover the sampled sets, scale them to the whole cache
+        SampleEstimate r = sampler->readEstimate(), w = sampler->writeEstimate();
+        cout << "SAMPLED ESTIMATES (95% CI)=================" << endl;
+        cout << "Est. read hits:    " << std::setprecision(0) << r.hits << endl;
+        cout << "Est. read misses:  " << r.misses << endl;
+        cout << "Est. read miss rate:  " << std::setprecision(2) << 100.0*r.missRate
+             << "% +/- " << 100.0*r.halfWidth << "%" << endl;
+        cout << "Est. write hits:   " << std::setprecision(0) << w.hits << endl;
+        cout << "Est. write misses: " << w.misses << endl;
+        cout << "Est. write miss rate: " << std::setprecision(2) << 100.0*w.missRate
+             << "% +/- " << 100.0*w.halfWidth << "%" << endl;
     }
 }
 
 
+// run the configured kernel with its progress lines muted, they would break up the comparison
+// tables; returns the seconds spent in the simulated loop, setup and check excluded
+double emulateQuietly(){
+    std::streambuf* out = cout.rdbuf(nullptr);
+    prepareKernel();
+    auto start = std::chrono::steady_clock::now();
+    runKernel();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    checkKernel();
+    cout.rdbuf(out);
+    cout.clear();   // writes to a null buffer set badbit
+    return seconds;
+}
 
-void constructMatrix(std::vector<std::vector<Address>>& a, std::vector<std::vector<Address>>& b,
-                     std::vector<std::vector<Address>>& c){
-
-    int address = 0;
-    for(int i=0; i<dimension; ++i){
-        for(int j=0; j<dimension; ++j){
-            a[i][j] = Address(address);
-            b[i][j] = Address(sz*dimension*dimension + address);
-            c[i][j] = Address(2*sz*dimension*dimension + address);
-            address += sz;
+// run every built-in kernel once in full and once sampled with the current
+// configuration, and check that the full miss rate falls inside the sampled CI
+void validateSampling(){
+    const AlgorithmPolicy algorithms[] = {AlgorithmPolicy::daxpy, AlgorithmPolicy::mxm, AlgorithmPolicy::mxm_block};
+    const char* names[] = {"daxpy", "mxm", "mxm_block"};
+    SamplingPolicy sampledPolicy = sampling;
+    if(sampledPolicy == SamplingPolicy::None || samplingRatio <= 1){
+        sampledPolicy = SamplingPolicy::Stride;
+        samplingRatio = 8;
+    }
+    AlgorithmPolicy savedAlgorithm = algorithm;
+    cout << "SAMPLING VALIDATION (1 in " << samplingRatio << " sets, "
+         << (sampledPolicy == SamplingPolicy::Stride ? "stride" : "hashed") << ")========" << endl;
+    cout << std::left << std::setw(11) << "kernel" << std::setw(10) << "full rd"
+         << std::setw(20) << "sampled rd" << std::setw(10) << "full wr"
+         << std::setw(20) << "sampled wr" << std::setw(9) << "speedup" << "in CI" << endl;
+
+    for(int k=0; k<3; ++k){
+        algorithm = algorithms[k];
+        double readRate[2], writeRate[2], seconds[2];
+        SampleEstimate r{}, w{};
+        for(int sampled=0; sampled<2; ++sampled){
+            sampling = sampled ? sampledPolicy : SamplingPolicy::None;
+            initializeEmulator();
+            seconds[sampled] = emulateQuietly();
+            readRate[sampled] = (double)Cache::readMiss / std::max(1, Cache::readHit + Cache::readMiss);
+            writeRate[sampled] = (double)Cache::writeMiss / std::max(1, Cache::writeHit + Cache::writeMiss);
+            if(sampler){
+                r = sampler->readEstimate();
+                w = sampler->writeEstimate();
+            }
         }
+        // a zero-width interval still counts when the estimate is exact
+        bool inside = std::abs(readRate[0] - r.missRate) <= r.halfWidth + 1e-9
+                   && std::abs(writeRate[0] - w.missRate) <= w.halfWidth + 1e-9;
+        std::ostringstream rd, wr;
+        rd << std::fixed << std::setprecision(2) << 100.0*r.missRate << "+/-" << 100.0*r.halfWidth << "%";
+        wr << std::fixed << std::setprecision(2) << 100.0*w.missRate << "+/-" << 100.0*w.halfWidth << "%";
+        cout << std::left << std::fixed << std::setprecision(2) << std::setw(11) << names[k]
+             << std::setw(10) << 100.0*readRate[0] << std::setw(20) << rd.str()
+             << std::setw(10) << 100.0*writeRate[0] << std::setw(20) << wr.str()
+             << std::setw(9) << seconds[0] / std::max(seconds[1], 1e-9) << (inside ? "yes" : "NO") << endl;
     }
+    cout << std::right;
+    algorithm = savedAlgorithm;
+    sampling = sampledPolicy;
+}
 
-    // insert some value in ram
-    int value = 1;
-    for(int i=0; i<dimension; ++i){
-        for(int j=0; j<dimension; ++j){
-            ram->setDouble(a[i][j], value);
-            ram->setDouble(b[i][j], value);
-            ram->setDouble(c[i][j], 0);
-            // increase value if necessary
+// run the current kernel once per index function and show how many misses
+// each removes compared to plain modulo indexing
+void compareIndexFunctions(){
+    const IndexFunction functions[] = {IndexFunction::Modulo, IndexFunction::XorFold,
+                                       IndexFunction::PrimeModulo, IndexFunction::Skewed};
+    const char* names[] = {"modulo", "xor-fold", "prime", "skewed"};
+    IndexFunction savedFunction = indexFunction;
+    long moduloMisses = 0;
+    cout << "INDEX FUNCTION COMPARISON==================" << endl;
+    cout << std::left << std::setw(10) << "index" << std::setw(10) << "read mr" << std::setw(10) << "write mr"
+         << std::setw(12) << "misses" << std::setw(10) << "seconds" << "miss reduction" << endl;
+    for(int f=0; f<4; ++f){
+        indexFunction = functions[f];
+        initializeEmulator();
+        double seconds = emulateQuietly();
+        long misses = (long)Cache::readMiss + Cache::writeMiss;
+        if(f == 0){
+            moduloMisses = misses;
         }
+        cout << std::left << std::fixed << std::setprecision(2) << std::setw(10) << names[f]
+             << std::setw(10) << 100.0*Cache::readMiss / std::max(1, Cache::readHit + Cache::readMiss)
+             << std::setw(10) << 100.0*Cache::writeMiss / std::max(1, Cache::writeHit + Cache::writeMiss)
+             << std::setw(12) << misses << std::setw(10) << seconds
+             << 100.0*(moduloMisses - misses) / std::max(1L, moduloMisses) << "%" << endl;
     }
-    cout << "Value initialized. " << endl;
+    cout << std::right;
+    indexFunction = savedFunction;
 }
 
+// run the current kernel with a TLB for every page size, to show what huge pages buy
+void compareTlbPageSizes(){
+    const PageSize sizes[] = {PageSize::Page4K, PageSize::Page2M, PageSize::Page1G};
+    const char* names[] = {"4K", "2M", "1G"};
+    bool savedEnabled = tlbEnabled;
+    PageSize savedSize = pageSize;
+    tlbEnabled = true;
+    cout << "TLB PAGE SIZE COMPARISON===================" << endl;
+    cout << std::left << std::setw(6) << "page" << std::setw(10) << "L1 hit%" << std::setw(12) << "walks"
+         << std::setw(14) << "walk refs" << std::setw(14) << "walk misses" << "cache misses" << endl;
+    for(int p=0; p<3; ++p){
+        pageSize = sizes[p];
+        initializeEmulator();
+        emulateQuietly();
+        const TlbLevel& first = tlb->getLevels()[0];
+        cout << std::left << std::fixed << std::setprecision(2) << std::setw(6) << names[p]
+             << std::setw(10) << 100.0*first.hits / std::max(1L, first.hits + first.misses)
+             << std::setw(12) << tlb->walks << std::setw(14) << tlb->walkReferences
+             << std::setw(14) << tlb->walkMisses << (long)Cache::readMiss + Cache::writeMiss << endl;
+    }
+    cout << std::right;
+    tlbEnabled = savedEnabled;
+    pageSize = savedSize;
+}
 
-void emulateMxm(){
-
-    // emulate C = A * B
-    // construct matrix of address
-    std::vector<std::vector<Address>>
-    a(dimension, std::vector<Address>(dimension)),
-    b(dimension, std::vector<Address>(dimension)),
-    c(dimension, std::vector<Address>(dimension));
-
-    constructMatrix(a, b, c);
+struct TuneResult{
+    int tileJ;
+    int tileK;
+    long misses;    // final count, or the count when the run was given up
+    bool aborted;
+};
 
-    // run naive mxm
-    double register1, register2, register3, register4;
-    for(int i=0; i<dimension; ++i){
-        for(int j=0; j<dimension; ++j){
-            register1 = 0.0;
-            for(int k=0; k<dimension; ++k){
-                register2 = cpu->loadDouble(a[i][k]);
-                register3 = cpu->loadDouble(b[k][j]);
-                register4 = cpu->multDouble(register2, register3);
-                register1 = cpu->addDouble(register1, register4);
+// the reference stream of emulateMxmBlock with tileJ x tileK tiles for the jj/kk loops,
+// run on the tag-only path. Gives up once the misses pass the best complete run so far.
+TuneResult tagOnlyMxmBlock(Cache& tagCache, int tileJ, int tileK, const std::atomic<long>& best){
+    const int matrix = dimension * dimension;
+    auto a = [&](int i, int j){ return Address(sz * (i*dimension + j)); };
+    auto b = [&](int i, int j){ return Address(sz * (matrix + i*dimension + j)); };
+    auto c = [&](int i, int j){ return Address(sz * (2*matrix + i*dimension + j)); };
+    long misses = 0;
+    for(int jj=0; jj<dimension; jj+=tileJ){
+        for(int kk=0; kk<dimension; kk+=tileK){
+            for(int i=0; i<dimension; ++i){
+                for(int j=jj; j<min(jj+tileJ, dimension); ++j){
+                    misses += !tagCache.warm(c(i, j));
+                    for(int k=kk; k<min(kk+tileK, dimension); ++k){
+                        misses += !tagCache.warm(a(i, k));
+                        misses += !tagCache.warm(b(k, j));
+                    }
+                    misses += !tagCache.warm(c(i, j));
+                }
+                if(misses > best.load(std::memory_order_relaxed)){
+                    return {tileJ, tileK, misses, true};
+                }
             }
-            cpu->storeDouble(c[i][j], register1);
         }
     }
+    return {tileJ, tileK, misses, false};
+}
 
-    for(int i=0; i<dimension; ++i){
-        for(int j=0; j<dimension; ++j){
-            assert(ram->getDouble(c[i][j]) == dimension);
+// search jj/kk tile shapes for mxm_block against the current cache configuration,
+// candidates run in parallel, each on its own cache instance
+void tuneMxmBlock(){
+    algorithm = AlgorithmPolicy::mxm_block;
+    initializeEmulator();   // sets the geometry; the tuning caches never read Ram
+
+    std::vector<int> sizes;
+    for(int size : tileSizes){
+        if(size >= 1 && size <= dimension){
+            sizes.push_back(size);
         }
     }
-
-    cout << "Mxm finished. " << endl;
-
-}
-
-void emulateMxmBlock(){
-
-
-
-    // emulate C = A * B
-    // construct matrix of address
-    std::vector<std::vector<Address>>
-            a(dimension, std::vector<Address>(dimension)),
-            b(dimension, std::vector<Address>(dimension)),
-            c(dimension, std::vector<Address>(dimension));
-
-    constructMatrix(a, b, c);
-
-    // run block mxm
-    double register1, register2, register3, register4, tmp;
-    int i, j, k, jj, kk;
-    for(jj=0; jj<dimension; jj+=blockingFactor){
-        for(kk=0; kk<dimension; kk+=blockingFactor){
-            for(i=0; i<dimension; ++i){
-                for(j=jj; j<min(jj+blockingFactor, dimension); ++j){
-                    register1 = cpu->loadDouble(c[i][j]);  // Load directly to register1
-//                    if((int)register1%32!=0 ){
-//                        int v1 = cpu->loadDouble(c[i][j]);
-//                        int v2 = ram->getDouble(c[i][j]);
-//                        cout << v1 << " " << v2 << endl;
-//                    }
-                    for(k=kk; k<min(kk+blockingFactor, dimension); ++k){
-                        register2 = cpu->loadDouble(a[i][k]);
-                        register3 = cpu->loadDouble(b[k][j]);
-                        register4 = cpu->multDouble(register2, register3);
-                        register1 = cpu->addDouble(register1, register4);
-                    }
-                    cpu->storeDouble(c[i][j], register1);  // Store from register1
-//                    if((int)register1%32!=0  || (int)(ram->getDouble(c[i][j]))%32!=0 ){
-//                        cout << register1 << endl;
-//                    }
-                }
+    // the current square tile is a candidate too and shows up in the landscape; a tile wider than
+    // the matrix runs as one of width dimension
+    int current = std::min(blockingFactor, dimension);
+    if(std::find(sizes.begin(), sizes.end(), current) == sizes.end()){
+        sizes.push_back(current);
+    }
+    std::sort(sizes.begin(), sizes.end());
+    // it goes first, so the abort bound is tight early
+    std::vector<std::pair<int, int>> candidates;
+    candidates.emplace_back(current, current);
+    for(int tileK : sizes){
+        for(int tileJ : sizes){
+            if(tileJ != current || tileK != current){
+                candidates.emplace_back(tileJ, tileK);
             }
         }
     }
 
-
-    for(i=0; i<dimension; ++i){
-        for(j=0; j<dimension; ++j){
-            assert(ram->getDouble(c[i][j]) == dimension);
-//            if(ram->getDouble(c[i][j])!=dimension){
-//                cout << ram->getDouble(c[i][j]) << endl;
-//            }
+    std::vector<TuneResult> results(candidates.size());
+    std::atomic<long> best(LONG_MAX);
+    std::atomic<int> next(0);
+    auto worker = [&](){
+        for(int n = next++; n < (int)candidates.size(); n = next++){
+            shared_ptr<Cache> tagCache = makeCache(ram);
+            results[n] = tagOnlyMxmBlock(*tagCache, candidates[n].first, candidates[n].second, best);
+            long seen = best.load();
+            while(!results[n].aborted && results[n].misses < seen && !best.compare_exchange_weak(seen, results[n].misses)){
+            }
+        }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for(int t=0; t<tuningThreads; ++t){
+        threads.emplace_back(worker);
+    }
+    for(auto& thread : threads){
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // per candidate: c is loaded and stored once per (i, j, kk), a and b once per (i, j, k)
+    auto references = [&](int tileK){
+        long tilesK = (dimension + tileK - 1) / tileK;
+        return 2L * dimension * dimension * tilesK + 2L * dimension * dimension * dimension;
+    };
+    const TuneResult* winner = nullptr;
+    int aborted = 0;
+    for(const auto& result : results){
+        aborted += result.aborted;
+        if(!result.aborted && (!winner || result.misses < winner->misses)){
+            winner = &result;
         }
     }
 
-    cout << "Mxm_block finished. " << endl;
+    cout << "TUNING mxm_block==========================" << endl;
+    cout << "Candidates:        " << candidates.size() << " (" << aborted << " aborted early), "
+         << tuningThreads << " threads, " << std::fixed << std::setprecision(2) << seconds << " s" << endl;
+    cout << "Best tile (jj x kk): " << winner->tileJ << " x " << winner->tileK << endl;
+    cout << "Best misses:       " << winner->misses << " ("
+         << 100.0*winner->misses / references(winner->tileK) << "% of references)" << endl;
+    cout << "Miss rate landscape in %, rows kk tile, columns jj tile, '>' is a lower bound of an aborted run" << endl;
+    cout << std::setw(6) << "kk\\jj";
+    for(int tileJ : sizes){
+        cout << std::setw(9) << tileJ;
+    }
+    cout << endl;
+    for(int tileK : sizes){
+        cout << std::setw(6) << tileK;
+        for(int tileJ : sizes){
+            for(const auto& result : results){
+                if(result.tileJ == tileJ && result.tileK == tileK){
+                    std::ostringstream cell;
+                    cell << (result.aborted ? ">" : "") << std::fixed << std::setprecision(2)
+                         << 100.0*result.misses / references(tileK);
+                    cout << std::setw(9) << cell.str();
+                    break;
+                }
+            }
+        }
+        cout << endl;
+    }
 }
 
 
@@ -336,17 +542,36 @@ int main(int argc, char** argv) {
 
     parseInput(argc, argv);
 
-    initializeEmulator();
+    try{
+        if(samplingValidation){
+            validateSampling();
+            return 0;
+        }
+        if(indexComparison){
+            compareIndexFunctions();
+            return 0;
+        }
+        if(tlbComparison){
+            compareTlbPageSizes();
+            return 0;
+        }
+        if(tuning){
+            tuneMxmBlock();
+            return 0;
+        }
 
-    printInput();
+        initializeEmulator();
 
-    switch (algorithm) {
-        case AlgorithmPolicy::daxpy:
-            emulateDaxpy(); break;
-        case AlgorithmPolicy::mxm:
-            emulateMxm(); break;
-        case AlgorithmPolicy::mxm_block:
-            emulateMxmBlock(); break;
+        printInput();
+
+        emulate();
+    }catch(const std::exception& e){
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if(Cpu::references < Cpu::fastForward){
+        std::cout << "Fast-forward did not finish: only " << Cpu::references << " references were made" << std::endl;
     }
 
     if(printEnabled){